@@ -0,0 +1,593 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include <sys/resource.h>
+
+// Generates a synthetic bibliography and times each phase of a conversion on
+// it. The corpus only depends on the options and the seed, so numbers from
+// different builds can be compared.
+
+// With glibc, allocations are counted by wrapping malloc, which also sees
+// those GLib makes. Sanitizers have their own malloc, which is left alone.
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define BENCH_ALLOCATIONS
+#endif
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#undef BENCH_ALLOCATIONS
+#endif
+#endif
+
+static gsize bench_allocations;
+
+#ifdef BENCH_ALLOCATIONS
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  g_atomic_pointer_add(&bench_allocations, 1);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  g_atomic_pointer_add(&bench_allocations, 1);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  g_atomic_pointer_add(&bench_allocations, 1);
+  return __libc_realloc(ptr, size);
+}
+#endif
+
+struct bench_options {
+  gint entries;
+  gdouble field_rate;
+  gint abstract_size;
+  gdouble non_ascii;
+  gdouble duplicates;
+  gdouble irregular;
+  gint seed;
+  gint jobs;
+  gint repeat;
+  gboolean bibtex;
+  gchar *write;
+  gchar *input;
+  gboolean check;
+  gint sweep;
+};
+
+// A sweep fails when parsing an entry of its largest corpus takes more than
+// this many times as long as one of its smallest.
+#define BENCH_SWEEP_MAX_RATIO 2.0
+
+static const gchar *ascii_words[] = {
+    "analysis", "approach", "bounded", "control", "data", "design", "dynamic", "efficient", "estimation", "evaluation",
+    "fast", "framework", "graph", "linear", "learning", "method", "model", "network", "nonlinear", "optimal",
+    "parallel", "performance", "predictive", "robust", "sampling", "scalable", "sparse", "stochastic", "system", "theory",
+    "time", "towards", "uncertainty", "using", "via", "with", "{\\\"u}ber", "na{\\\"\\i}ve", "{GPU}", "{MPC}",
+};
+
+static const gchar *non_ascii_words[] = {
+    "Müller", "Ångström", "naïve", "Škoda", "Łódź", "façade", "über", "Zürich", "São", "Γ-function", "Δ-robust", "Kőnig",
+};
+
+static const gchar *surnames[] = {
+    "Smith", "Silva", "Sousa", "Garcia", "Nguyen", "Kim", "Müller", "Rossi", "Dubois", "Novák", "Jensen", "Kowalski",
+};
+
+static const gchar *given_names[] = {
+    "Ana", "John", "Maria", "Wei", "Jonas", "Lucía", "Pierre", "Eva", "Ravi", "Olga", "Hiroshi", "Zoë",
+};
+
+static const gchar *months[] = {
+    "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec",
+};
+
+struct bench_type {
+  const gchar *name;
+  const gchar *container;
+  gint weight;
+};
+
+// Rough proportions of a typical thesis bibliography.
+static const struct bench_type types[] = {
+    {"article",       "journal",      40},
+    {"inproceedings", "booktitle",    30},
+    {"book",          "publisher",    8 },
+    {"incollection",  "booktitle",    6 },
+    {"phdthesis",     "school",       5 },
+    {"mastersthesis", "school",       3 },
+    {"techreport",    "institution",  4 },
+    {"misc",          "howpublished", 4 },
+};
+
+#define pick(R, A) (A)[g_rand_int_range(R, 0, G_N_ELEMENTS(A))]
+
+static void bench_words(GString *out, GRand *rand, const struct bench_options *options, gint count) {
+  for (gint i = 0; i < count; i++) {
+    if (i > 0) {
+      g_string_append_c(out, ' ');
+    }
+
+    if (g_rand_double(rand) < options->non_ascii) {
+      g_string_append(out, pick(rand, non_ascii_words));
+    } else {
+      g_string_append(out, pick(rand, ascii_words));
+    }
+  }
+}
+
+static void bench_authors(GString *out, GRand *rand) {
+  gint count = g_rand_int_range(rand, 1, 7);
+
+  for (gint i = 0; i < count; i++) {
+    if (i > 0) {
+      g_string_append(out, " and ");
+    }
+
+    g_string_append_printf(out, "%s, %s", pick(rand, surnames), pick(rand, given_names));
+  }
+}
+
+static void bench_entry(GString *out, GRand *rand, const struct bench_options *options, guint index) {
+  // Forms the fast scanner leaves to tree-sitter. The generator is only asked
+  // for them when wanted, so that other corpora stay as they were.
+  gint irregular = -1;
+  if (options->irregular > 0 && g_rand_double(rand) < options->irregular) {
+    irregular = g_rand_int_range(rand, 0, 3);
+  }
+
+  if (irregular == 0) {
+    g_string_append_printf(out, "@string{venue%u = {Workshop %u}}\n\n", index, index);
+  } else if (irregular == 1) {
+    g_string_append(out, "@comment{jabref-meta: databaseType:biblatex;}\n\n");
+  }
+
+  gint total = 0;
+  for (gsize i = 0; i < G_N_ELEMENTS(types); i++) {
+    total += types[i].weight;
+  }
+
+  const struct bench_type *type = &types[0];
+  gint roll = g_rand_int_range(rand, 0, total);
+  for (gsize i = 0; i < G_N_ELEMENTS(types); i++) {
+    if (roll < types[i].weight) {
+      type = &types[i];
+      break;
+    }
+    roll -= types[i].weight;
+  }
+
+  guint key = index;
+  if (index > 0 && g_rand_double(rand) < options->duplicates) {
+    key = g_rand_int_range(rand, 0, index);
+  }
+
+  gint year = g_rand_int_range(rand, 1950, 2025);
+
+  g_string_append_printf(out, "@%s{key%u,\n  author = {", type->name, key);
+  bench_authors(out, rand);
+  g_string_append(out, "},\n  title = {{");
+  bench_words(out, rand, options, g_rand_int_range(rand, 4, 15));
+  g_string_append_printf(out, "}},\n  year = %d,\n  %s = {", year, type->container);
+  bench_words(out, rand, options, g_rand_int_range(rand, 2, 6));
+  g_string_append(out, "},\n");
+
+  if (irregular == 0) {
+    g_string_append_printf(out, "  note = venue%u # { (extended)},\n", index);
+  } else if (irregular == 1) {
+    g_string_append(out, "  note = {Sets \\{x\\} and \\{y\\}},\n");
+  } else if (irregular == 2) {
+    g_string_append(out, "  % added by hand\n");
+  }
+
+#define optional(...)                            \
+  if (g_rand_double(rand) < options->field_rate) { \
+    g_string_append_printf(out, "  " __VA_ARGS__); \
+  }
+
+  optional("month = %s,\n", pick(rand, months));
+  optional("volume = {%d},\n", g_rand_int_range(rand, 1, 80));
+  optional("number = \"%d\",\n", g_rand_int_range(rand, 1, 12));
+  optional("pages = {%d--%d},\n", g_rand_int_range(rand, 1, 500), g_rand_int_range(rand, 500, 900));
+  optional("doi = {10.%d/%08x},\n", g_rand_int_range(rand, 1000, 9999), g_rand_int(rand));
+  optional("url = {https://example.org/papers/%u},\n", index);
+  optional("isbn = {978-%d-%d-%d},\n", g_rand_int_range(rand, 0, 9), g_rand_int_range(rand, 1000, 9999), g_rand_int_range(rand, 100, 999));
+  optional("address = {%s},\n", pick(rand, non_ascii_words));
+
+#undef optional
+
+  // As arXiv exports them. Printed as BibTeX, eprinttype becomes archiveprefix,
+  // the longest name of the entry when there is no DOI.
+  if (g_rand_double(rand) < options->field_rate) {
+    g_string_append_printf(out, "  eprint = {%02d%02d.%05d},\n", year % 100, g_rand_int_range(rand, 1, 13), g_rand_int_range(rand, 0, 99999));
+    g_string_append(out, "  archivePrefix = {arXiv},\n  primaryClass = {cs.CL},\n");
+  }
+
+  if (g_rand_double(rand) < options->field_rate) {
+    g_string_append(out, "  keywords = {");
+    bench_words(out, rand, options, g_rand_int_range(rand, 2, 6));
+    g_string_append(out, "},\n");
+  }
+
+  // Abstracts dominate the size of real files, so their length varies around
+  // the requested size.
+  if (options->abstract_size > 0 && g_rand_double(rand) < options->field_rate) {
+    gsize target = g_rand_int_range(rand, options->abstract_size / 2, options->abstract_size * 3 / 2 + 1);
+    gsize start = out->len;
+
+    g_string_append(out, "  abstract = {");
+    bench_words(out, rand, options, 12);
+    while (out->len - start < target) {
+      g_string_append(out, ".\n    ");
+      bench_words(out, rand, options, 12);
+    }
+    g_string_append(out, ".},\n");
+  }
+
+  g_string_append(out, "}\n\n");
+}
+
+static GBytes *bench_corpus(const struct bench_options *options) {
+  g_autoptr(GRand) rand = g_rand_new_with_seed(options->seed);
+  GString *out = g_string_new(NULL);
+
+  for (gint i = 0; i < options->entries; i++) {
+    bench_entry(out, rand, options, i);
+  }
+
+  return g_string_free_to_bytes(out);
+}
+
+static void bench_discard(const gchar *string) {
+  (void)string;
+}
+
+static void bench_report(const gchar *phase, gint64 usec, gsize bytes, guint entries) {
+  gdouble seconds = MAX(usec, 1) / 1e6;
+  g_print("%-10s %10.3f %12.1f %14.0f\n", phase, seconds * 1e3, bytes / seconds / (1024 * 1024), entries / seconds);
+}
+
+// Resolves every pending value, which is the normalization the printer would
+// otherwise do as it goes.
+static void bench_normalize(BIBEntryList *list) {
+  for (guint i = 0; i < list->entries->len; i++) {
+    BIBEntry *entry = g_ptr_array_index(list->entries, i);
+
+    for (guint j = 0; j < entry->n_fields; j++) {
+      g_auto(BIBString) value = bib_string_resolve(&entry->fields[j].value);
+    }
+  }
+}
+
+static void bench_shuffle(BIBEntryList *list, GRand *rand) {
+  GPtrArray *entries = list->entries;
+
+  for (guint i = entries->len; i > 1; i--) {
+    guint j = g_rand_int_range(rand, 0, i);
+    gpointer tmp = entries->pdata[i - 1];
+    entries->pdata[i - 1] = entries->pdata[j];
+    entries->pdata[j] = tmp;
+  }
+}
+
+static gboolean bench_same_entry(BIBEntry *a, BIBEntry *b) {
+  if (!bib_string_equal(&a->type, &b->type) || !bib_string_equal(&a->key, &b->key) || a->n_fields != b->n_fields) {
+    return FALSE;
+  }
+
+  for (guint i = 0; i < a->n_fields; i++) {
+    g_auto(BIBString) value_a = bib_string_resolve(&a->fields[i].value);
+    g_auto(BIBString) value_b = bib_string_resolve(&b->fields[i].value);
+
+    if (a->fields[i].id != b->fields[i].id || !bib_string_equal(&value_a, &value_b)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+// Parses the corpus with tree-sitter alone and again with the fast scanner,
+// which must give the same entries in the same order, whatever it declined.
+static gboolean bench_check(const struct bench_options *options, GBytes *corpus) {
+  g_autoptr(GError) error = NULL;
+
+  bib_parse_set_fast_scan(FALSE);
+  g_autoptr(BIBEntryList) expected = bib_parse_unsorted(corpus, options->jobs, &error);
+
+  if (expected == NULL) {
+    g_printerr("Error: %s\n", error->message);
+    return FALSE;
+  }
+
+  // Only to count what the scanner declined.
+  bib_stats_enable(BIB_STATS_TEXT);
+  bib_parse_set_fast_scan(TRUE);
+  g_autoptr(BIBEntryList) actual = bib_parse_unsorted(corpus, options->jobs, &error);
+  bib_stats_enable(BIB_STATS_OFF);
+
+  if (actual == NULL) {
+    g_printerr("Error: %s\n", error->message);
+    return FALSE;
+  }
+
+  guint n = MIN(expected->entries->len, actual->entries->len);
+  guint mismatches = 0;
+
+  for (guint i = 0; i < n; i++) {
+    BIBEntry *a = g_ptr_array_index(expected->entries, i);
+    BIBEntry *b = g_ptr_array_index(actual->entries, i);
+
+    if (!bench_same_entry(a, b) && mismatches++ < 10) {
+      g_print("entry %u differs: %.*s with tree-sitter, %.*s with the fast scanner\n", i, bib_string_args(&a->key), bib_string_args(&b->key));
+    }
+  }
+
+  g_print("checked %u entries, %" G_GSIZE_FORMAT " declined by the fast scanner\n", expected->entries->len, bib_stats.declined);
+
+  if (expected->entries->len != actual->entries->len) {
+    g_print("%u entries with tree-sitter, %u with the fast scanner\n", expected->entries->len, actual->entries->len);
+    return FALSE;
+  }
+
+  if (mismatches > 0) {
+    g_print("%u entries differ\n", mismatches);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean bench_run(const struct bench_options *options, GBytes *corpus) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GRand) rand = g_rand_new_with_seed(options->seed);
+  gint64 best[5] = {G_MAXINT64, G_MAXINT64, G_MAXINT64, G_MAXINT64, G_MAXINT64};
+  gsize size = g_bytes_get_size(corpus);
+
+  gint null_fd = g_open("/dev/null", O_WRONLY, 0);
+
+  if (null_fd < 0) {
+    g_printerr("Could not open /dev/null\n");
+    return FALSE;
+  }
+
+  // Duplicate keys are reported while printing; that is not what is measured.
+  GPrintFunc printerr = g_set_printerr_handler(bench_discard);
+
+  guint entries = 0;
+  gsize blocks = 0;
+  gsize allocated = 0;
+  gsize allocations[2] = {0};
+
+  for (gint run = 0; run < options->repeat; run++) {
+    gsize first_allocation = g_atomic_pointer_get(&bench_allocations);
+    gint64 start = g_get_monotonic_time();
+    g_autoptr(BIBEntryList) list = bib_parse(corpus, options->jobs, &error);
+    best[0] = MIN(best[0], g_get_monotonic_time() - start);
+    allocations[0] = g_atomic_pointer_get(&bench_allocations) - first_allocation;
+
+    if (list == NULL) {
+      break;
+    }
+
+    start = g_get_monotonic_time();
+    bench_normalize(list);
+    best[1] = MIN(best[1], g_get_monotonic_time() - start);
+
+    bench_shuffle(list, rand);
+    start = g_get_monotonic_time();
+    bib_entry_list_sort(list, options->jobs);
+    best[2] = MIN(best[2], g_get_monotonic_time() - start);
+
+    start = g_get_monotonic_time();
+    BIBSink *sink = bib_sink_new_fd(null_fd);
+    bib_entry_list_print(sink, list, BIB_OUTPUT_BIB, options->bibtex, options->jobs);
+    bib_sink_close(sink, NULL);
+    best[3] = MIN(best[3], g_get_monotonic_time() - start);
+
+    entries = list->entries->len;
+    blocks = 0;
+    allocated = 0;
+
+    for (guint i = 0; i < list->arenas->len; i++) {
+      gsize arena_blocks = 0;
+      gsize arena_allocated = 0;
+      bib_arena_stats(g_ptr_array_index(list->arenas, i), &arena_blocks, &arena_allocated);
+      blocks += arena_blocks;
+      allocated += arena_allocated;
+    }
+
+    start = g_get_monotonic_time();
+    g_clear_pointer(&list, bib_entry_list_free);
+    best[4] = MIN(best[4], g_get_monotonic_time() - start);
+    allocations[1] = g_atomic_pointer_get(&bench_allocations) - first_allocation;
+  }
+
+  g_set_printerr_handler(printerr);
+  g_close(null_fd, NULL);
+
+  if (error != NULL) {
+    g_printerr("Error: %s\n", error->message);
+    return FALSE;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  g_print("corpus: %u entries, %.1f MiB, %d job(s), best of %d\n\n", entries, size / (1024.0 * 1024.0), options->jobs, options->repeat);
+  g_print("%-10s %10s %12s %14s\n", "phase", "ms", "MiB/s", "entries/s");
+  bench_report("parse", best[0], size, entries);
+  bench_report("normalize", best[1], size, entries);
+  bench_report("sort", best[2], size, entries);
+  bench_report("print", best[3], size, entries);
+  bench_report("free", best[4], size, entries);
+  bench_report("total", best[0] + best[1] + best[2] + best[3] + best[4], size, entries);
+  g_print("\narena: %" G_GSIZE_FORMAT " blocks, %.1f MiB, %.0f bytes/entry\n", blocks, allocated / (1024.0 * 1024.0), entries > 0 ? (gdouble)allocated / entries : 0.0);
+#ifdef BENCH_ALLOCATIONS
+  g_print("allocations: %" G_GSIZE_FORMAT " to parse, %.1f/entry, %" G_GSIZE_FORMAT " in all\n", allocations[0], entries > 0 ? (gdouble)allocations[0] / entries : 0.0, allocations[1]);
+#endif
+  g_print("peak rss: %.1f MiB\n", usage.ru_maxrss / 1024.0);
+
+  return TRUE;
+}
+
+// Parses corpora of N, 2N, 4N... entries, to check that the time per entry
+// stays flat as the input grows.
+static gboolean bench_sweep(const struct bench_options *options) {
+  struct bench_options sized = *options;
+  gdouble first = 0;
+  gdouble ratio = 0;
+
+  g_print("%10s %10s %12s %8s\n", "entries", "ms", "ns/entry", "ratio");
+
+  for (gint i = 0; i < options->sweep; i++) {
+    sized.entries = options->entries << i;
+    g_autoptr(GBytes) corpus = bench_corpus(&sized);
+    gint64 best = G_MAXINT64;
+    guint entries = 0;
+
+    for (gint run = 0; run < options->repeat; run++) {
+      g_autoptr(GError) error = NULL;
+      gint64 start = g_get_monotonic_time();
+      g_autoptr(BIBEntryList) list = bib_parse(corpus, options->jobs, &error);
+      best = MIN(best, g_get_monotonic_time() - start);
+
+      if (list == NULL) {
+        g_printerr("Error: %s\n", error->message);
+        return FALSE;
+      }
+
+      entries = list->entries->len;
+    }
+
+    gdouble per_entry = MAX(best, 1) * 1e3 / MAX(entries, 1);
+
+    if (i == 0) {
+      first = per_entry;
+    }
+
+    ratio = per_entry / first;
+    g_print("%10u %10.3f %12.1f %8.2f\n", entries, best / 1e3, per_entry, ratio);
+  }
+
+  if (ratio > BENCH_SWEEP_MAX_RATIO) {
+    g_print("\nparse time per entry grew %.2f times over the sweep\n", ratio);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+int main(int argc, char **argv) {
+  struct bench_options options = {
+      .entries = 20000,
+      .field_rate = 0.6,
+      .abstract_size = 600,
+      .non_ascii = 0.05,
+      .duplicates = 0.01,
+      .seed = 1,
+      .jobs = 1,
+      .repeat = 3,
+  };
+
+  GOptionEntry entries[] = {
+      {"entries",       'n', 0, G_OPTION_ARG_INT,      &options.entries,       "Number of entries to generate (default: 20000)",                "N"},
+      {"field-rate",    0,   0, G_OPTION_ARG_DOUBLE,   &options.field_rate,    "Chance of each optional field being present (default: 0.6)",    "P"},
+      {"abstract-size", 0,   0, G_OPTION_ARG_INT,      &options.abstract_size, "Average abstract size in bytes, 0 for none (default: 600)",     "BYTES"},
+      {"non-ascii",     0,   0, G_OPTION_ARG_DOUBLE,   &options.non_ascii,     "Share of words with non-ASCII characters (default: 0.05)",      "P"},
+      {"duplicates",    0,   0, G_OPTION_ARG_DOUBLE,   &options.duplicates,    "Share of entries reusing an earlier key (default: 0.01)",       "P"},
+      {"irregular",     0,   0, G_OPTION_ARG_DOUBLE,   &options.irregular,     "Share of entries left to tree-sitter (default: 0)",             "P"},
+      {"seed",          0,   0, G_OPTION_ARG_INT,      &options.seed,          "Seed for the generator (default: 1)",                           "N"},
+      {"jobs",          'j', 0, G_OPTION_ARG_INT,      &options.jobs,          "Convert using N threads (0 for all cores)",                     "N"},
+      {"repeat",        'r', 0, G_OPTION_ARG_INT,      &options.repeat,        "Run each phase N times and keep the best (default: 3)",         "N"},
+      {"bibtex",        'b', 0, G_OPTION_ARG_NONE,     &options.bibtex,        "Output for bibtex instead of biblatex",                         ""},
+      {"write",         'w', 0, G_OPTION_ARG_FILENAME, &options.write,         "Only write the generated corpus to FILE",                       "FILE"},
+      {"input",         'i', 0, G_OPTION_ARG_FILENAME, &options.input,         "Use FILE as the corpus instead of generating one",              "FILE"},
+      {"check",         0,   0, G_OPTION_ARG_NONE,     &options.check,         "Compare the fast scanner with tree-sitter on the corpus",       ""},
+      {"sweep",         0,   0, G_OPTION_ARG_INT,      &options.sweep,         "Time parsing K corpora of N, 2N, 4N... entries",                "K"},
+      G_OPTION_ENTRY_NULL
+  };
+
+  setlocale(LC_ALL, "en_US.UTF-8");
+
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOptionContext) context = g_option_context_new(NULL);
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_print("option parsing failed: %s\n", error->message);
+    return 1;
+  }
+
+  if (options.entries < 0 || options.repeat <= 0) {
+    g_print("option parsing failed: --entries and --repeat must be positive\n");
+    return 1;
+  }
+
+  if (options.sweep < 0 || options.sweep > 16 || options.entries > G_MAXINT >> options.sweep) {
+    g_print("option parsing failed: --sweep must be between 0 and 16, and fit --entries doubled as many times\n");
+    return 1;
+  }
+
+  if (options.sweep > 0 && (options.input != NULL || options.write != NULL || options.check)) {
+    g_print("option parsing failed: --sweep generates its own corpora\n");
+    return 1;
+  }
+
+  if (options.jobs <= 0) {
+    options.jobs = g_get_num_processors();
+  }
+
+  if (options.sweep > 0) {
+    gboolean ok = bench_sweep(&options);
+    bib_free_regex();
+    return ok ? 0 : 1;
+  }
+
+  g_autoptr(GBytes) corpus = options.input != NULL ? bib_file_read(options.input, &error) : bench_corpus(&options);
+
+  if (corpus == NULL) {
+    g_printerr("Error reading file: %s\n", error->message);
+    return 1;
+  }
+
+  if (options.write != NULL) {
+    gsize size = 0;
+    const gchar *data = g_bytes_get_data(corpus, &size);
+
+    if (!g_file_set_contents(options.write, data, size, &error)) {
+      g_printerr("Error writing file: %s\n", error->message);
+      return 1;
+    }
+
+    return 0;
+  }
+
+  gboolean ok = options.check ? bench_check(&options, corpus) : bench_run(&options, corpus);
+
+  bib_free_regex();
+
+  return ok ? 0 : 1;
+}
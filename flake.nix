@@ -30,6 +30,7 @@
           pcre2 # gio
           tree-sitter
           util-linux # gio (libmount)
+          zstd # --compress=zstd, zstd input
         ];
       in
       rec {
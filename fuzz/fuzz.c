@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs each input through bib_parse and bib_entry_list_print, in every output
+// format, and aborts when one of these properties does not hold:
+//
+//   - the fast scanner and tree-sitter give the same entries;
+//   - the JSON outputs are valid UTF-8;
+//   - the input compressed with gzip and zstd reads back as it was;
+//   - the arena memory is linear in the size of the input;
+//   - converting the input repeated BIB_FUZZ_SCALE times takes no memory, and
+//     no output blocks, superlinear in the repetitions.
+//
+// Crashes, leaks and undefined behaviour are left to the sanitizers the
+// harness is built with (-DBIB_CONVERTER_FUZZ=ON). Built with Clang this is a
+// libFuzzer target; otherwise it converts the files given, or stdin, which is
+// what AFL runs. fuzz/corpus has seeds for either. BIB_FUZZ_SCALE=1 skips the
+// repetitions.
+//
+// Time is only checked with BIB_FUZZ_TIMING set: under the sanitizers, wall
+// clock ratios are too noisy to abort on, and findings must reproduce.
+
+#define FUZZ_BYTES_PER_BYTE 512
+#define FUZZ_BYTES_BASE (256 * 1024)
+#define FUZZ_SLACK 4
+#define FUZZ_MIN_USEC 20000
+
+struct fuzz_cost {
+  gint64 usec;
+  gsize allocated;
+  gsize sink_blocks;
+};
+
+static guint scale = 8;
+static gboolean timing = FALSE;
+
+// Printed with stdio, as GLib's printerr handler is silenced.
+#define fuzz_fail(...)             \
+  G_STMT_START {                   \
+    fprintf(stderr, __VA_ARGS__);  \
+    fprintf(stderr, "\n");         \
+    abort();                       \
+  }                                \
+  G_STMT_END
+
+static void fuzz_discard(const gchar *string) {
+  (void)string;
+}
+
+static gsize fuzz_allocated(BIBEntryList *list) {
+  gsize total = 0;
+
+  for (guint i = 0; i < list->arenas->len; i++) {
+    gsize blocks = 0;
+    gsize allocated = 0;
+    bib_arena_stats(g_ptr_array_index(list->arenas, i), &blocks, &allocated);
+    total += allocated;
+  }
+
+  return total;
+}
+
+static gboolean fuzz_same_entry(BIBEntry *a, BIBEntry *b) {
+  if (!bib_string_equal(&a->type, &b->type) || !bib_string_equal(&a->key, &b->key) || a->n_fields != b->n_fields) {
+    return FALSE;
+  }
+
+  for (guint i = 0; i < a->n_fields; i++) {
+    g_auto(BIBString) value_a = bib_string_resolve(&a->fields[i].value);
+    g_auto(BIBString) value_b = bib_string_resolve(&b->fields[i].value);
+
+    if (a->fields[i].id != b->fields[i].id || !bib_string_equal(&value_a, &value_b)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static void fuzz_print(BIBEntryList *list, BIBOutputFormat format, gboolean bibtex) {
+  BIBSink *sink = bib_sink_new();
+  bib_entry_list_print(sink, list, format, bibtex, 1);
+  g_autoptr(GBytes) output = bib_sink_free_to_bytes(sink);
+
+  gsize length = 0;
+  const gchar *text = g_bytes_get_data(output, &length);
+
+  if (format != BIB_OUTPUT_BIB && !g_utf8_validate(text, length, NULL)) {
+    fuzz_fail("format %d: output is not valid UTF-8", format);
+  }
+}
+
+static void fuzz_compress(const guint8 *data, gsize size, BIBCompression compression) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOutputStream) memory = g_memory_output_stream_new_resizable();
+  g_autoptr(GOutputStream) out = bib_compress_output(memory, compression, &error);
+
+  // Built without zstd.
+  if (out == NULL) {
+    return;
+  }
+
+  if (!g_output_stream_write_all(out, data, size, NULL, NULL, &error) || !g_output_stream_close(out, NULL, &error)) {
+    fuzz_fail("compression %d: %s", compression, error->message);
+  }
+
+  g_autoptr(GBytes) compressed = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(memory));
+  g_autoptr(GInputStream) raw = g_memory_input_stream_new_from_bytes(compressed);
+  g_autoptr(GInputStream) in = bib_decompress_input(raw, &error);
+  g_autoptr(GByteArray) decompressed = g_byte_array_new();
+  guint8 buffer[4096];
+  gssize length = 0;
+
+  while (in != NULL && (length = g_input_stream_read(in, buffer, sizeof(buffer), NULL, &error)) > 0) {
+    g_byte_array_append(decompressed, buffer, length);
+  }
+
+  if (error != NULL) {
+    fuzz_fail("compression %d: %s", compression, error->message);
+  }
+
+  if (decompressed->len != size || memcmp(decompressed->data, data, size) != 0) {
+    fuzz_fail("compression %d: %u bytes read back for %" G_GSIZE_FORMAT, compression, decompressed->len, size);
+  }
+}
+
+static struct fuzz_cost fuzz_convert(const guint8 *data, gsize size) {
+  g_autoptr(GBytes) input = g_bytes_new_static(data, size);
+  g_autoptr(GError) expected_error = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize sink_blocks = bib_stats.sink_blocks;
+  gint64 start = g_get_monotonic_time();
+
+  bib_parse_set_fast_scan(FALSE);
+  g_autoptr(BIBEntryList) expected = bib_parse(input, 1, &expected_error);
+  bib_parse_set_fast_scan(TRUE);
+  g_autoptr(BIBEntryList) list = bib_parse(input, 1, &error);
+
+  if (expected == NULL || list == NULL) {
+    // Rejecting an input is fine, as long as both paths do.
+    if ((expected == NULL) != (list == NULL)) {
+      fuzz_fail("only one of tree-sitter and the fast scanner failed");
+    }
+    return (struct fuzz_cost){.usec = g_get_monotonic_time() - start};
+  }
+
+  if (expected->entries->len != list->entries->len) {
+    fuzz_fail("%u entries with tree-sitter, %u with the fast scanner", expected->entries->len, list->entries->len);
+  }
+
+  for (guint i = 0; i < list->entries->len; i++) {
+    if (!fuzz_same_entry(g_ptr_array_index(expected->entries, i), g_ptr_array_index(list->entries, i))) {
+      fuzz_fail("entry %u differs between tree-sitter and the fast scanner", i);
+    }
+  }
+
+  fuzz_print(list, BIB_OUTPUT_BIB, FALSE);
+  fuzz_print(list, BIB_OUTPUT_BIB, TRUE);
+  fuzz_print(list, BIB_OUTPUT_NDJSON, FALSE);
+  fuzz_print(list, BIB_OUTPUT_CSL, FALSE);
+
+  return (struct fuzz_cost){
+      .usec = g_get_monotonic_time() - start,
+      .allocated = fuzz_allocated(expected) + fuzz_allocated(list),
+      .sink_blocks = bib_stats.sink_blocks - sink_blocks,
+  };
+}
+
+static void fuzz_one(const guint8 *data, gsize size) {
+  struct fuzz_cost cost = fuzz_convert(data, size);
+
+  fuzz_compress(data, size, BIB_COMPRESSION_GZIP);
+  fuzz_compress(data, size, BIB_COMPRESSION_ZSTD);
+
+  // Both lists count, so twice the budget.
+  if (cost.allocated > 2 * (FUZZ_BYTES_PER_BYTE * size + FUZZ_BYTES_BASE)) {
+    fuzz_fail("%" G_GSIZE_FORMAT " arena bytes for %" G_GSIZE_FORMAT " bytes of input", cost.allocated, size);
+  }
+
+  if (scale <= 1 || size == 0) {
+    return;
+  }
+
+  g_autofree guint8 *repeated = g_malloc(size * scale);
+
+  for (guint i = 0; i < scale; i++) {
+    memcpy(repeated + i * size, data, size);
+  }
+
+  struct fuzz_cost scaled = fuzz_convert(repeated, size * scale);
+
+  if (timing && scaled.usec > FUZZ_MIN_USEC && scaled.usec > cost.usec * scale * FUZZ_SLACK) {
+    fuzz_fail("%" G_GINT64_FORMAT " us for the input, %" G_GINT64_FORMAT " us for it repeated %u times", cost.usec, scaled.usec, scale);
+  }
+
+  if (scaled.allocated > (cost.allocated + FUZZ_BYTES_BASE) * scale * FUZZ_SLACK) {
+    fuzz_fail("%" G_GSIZE_FORMAT " arena bytes for the input, %" G_GSIZE_FORMAT " for it repeated %u times", cost.allocated, scaled.allocated, scale);
+  }
+
+  if (scaled.sink_blocks > (cost.sink_blocks + 1) * scale * FUZZ_SLACK) {
+    fuzz_fail("%" G_GSIZE_FORMAT " sink blocks for the input, %" G_GSIZE_FORMAT " for it repeated %u times", cost.sink_blocks, scaled.sink_blocks, scale);
+  }
+}
+
+static void fuzz_init(void) {
+  setlocale(LC_ALL, "en_US.UTF-8");
+
+  // Duplicate keys are reported while printing, which is only noise here.
+  g_set_printerr_handler(fuzz_discard);
+
+  // The counters are read, never reported.
+  bib_stats_enable(BIB_STATS_TEXT);
+
+  const gchar *value = g_getenv("BIB_FUZZ_SCALE");
+
+  if (value != NULL) {
+    scale = g_ascii_strtoull(value, NULL, 10);
+  }
+
+  timing = g_getenv("BIB_FUZZ_TIMING") != NULL;
+}
+
+#ifdef BIB_FUZZ_LIBFUZZER
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+  fuzz_init();
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzz_one(data, size);
+  return 0;
+}
+
+#else
+
+int main(int argc, char **argv) {
+  fuzz_init();
+
+  for (gint i = argc > 1 ? 1 : 0; i < argc; i++) {
+    const gchar *path = argc > 1 ? argv[i] : "/dev/stdin";
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, &error)) {
+      fprintf(stderr, "Error reading file: %s\n", error->message);
+      return 1;
+    }
+
+    fuzz_one((const guint8 *)contents, length);
+  }
+
+  bib_free_regex();
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// libbibconverter converts BibTeX/biblatex text in-process, the way the
+// bib-converter executable does. Input is fed in pieces of any size, and each
+// converted entry is handed to a callback as soon as it is complete.
+//
+//   BIBConverter *converter = bib_converter_new(BIB_CONVERTER_BIBTEX, on_entry, NULL);
+//   while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+//     bib_converter_feed(converter, buffer, length, &error);
+//   }
+//   bib_converter_finish(converter, &error);
+//   bib_converter_free(converter);
+//
+// A converter must only be used from one thread at a time, but any number of
+// them can run on different threads.
+
+#if defined(__GNUC__)
+#define BIB_CONVERTER_API __attribute__((visibility("default")))
+#else
+#define BIB_CONVERTER_API
+#endif
+
+typedef enum {
+  // Convert to BibTeX instead of biblatex.
+  BIB_CONVERTER_BIBTEX = 1 << 0,
+  // Hand out the entries sorted by key, as the executable prints them. This
+  // holds every entry until bib_converter_finish.
+  BIB_CONVERTER_SORTED = 1 << 1,
+  // Hand out each entry as a JSON object, as --format=ndjson prints it.
+  BIB_CONVERTER_JSON = 1 << 2,
+} BIBConverterFlags;
+
+// A converted entry. The strings are not NUL-terminated, and are only valid
+// during the callback.
+typedef struct {
+  const gchar *type;
+  gsize type_length;
+  const gchar *key;
+  gsize key_length;
+  // The whole entry, formatted as the executable prints it, without the
+  // newlines that end it.
+  const gchar *text;
+  gsize text_length;
+} BIBConverterEntry;
+
+typedef void (*BIBConverterEntryFunc)(const BIBConverterEntry *entry, gpointer user_data);
+
+typedef struct BIBConverter BIBConverter;
+
+BIB_CONVERTER_API BIBConverter *bib_converter_new(BIBConverterFlags flags, BIBConverterEntryFunc func, gpointer user_data);
+
+// Number of threads to convert with, 0 for all cores. Defaults to 1.
+BIB_CONVERTER_API void bib_converter_set_jobs(BIBConverter *converter, guint jobs);
+
+// Entries are converted once enough complete ones have been fed, so callbacks
+// can come from any call to feed or finish. Entries whose key was already seen
+// are dropped, keeping the first.
+BIB_CONVERTER_API gboolean bib_converter_feed(BIBConverter *converter, const gchar *data, gsize length, GError **error);
+
+// Converts whatever is left. Nothing can be fed afterwards.
+BIB_CONVERTER_API gboolean bib_converter_finish(BIBConverter *converter, GError **error);
+
+BIB_CONVERTER_API void bib_converter_free(BIBConverter *converter);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(BIBConverter, bib_converter_free)
+
+G_END_DECLS
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bibconverter.h"
+#include "internal.h"
+
+#include <string.h>
+
+// Fed bytes collect in a pending buffer, split at top-level `@` the same way
+// --stream splits its input. Once enough complete entries have built up they
+// are cut off into a chunk and converted together, so that parsing amortizes
+// over many entries and can use several threads; the incomplete entry at the
+// end waits for more input.
+//
+// Unsorted, each chunk is handed out and freed right away, so memory stays
+// bounded by the chunk size. Sorted, the chunks have to be kept until the
+// end, since the first entry in key order may be the last one fed.
+
+#define BIB_CONVERTER_CHUNK_SIZE (1024 * 1024)
+
+struct BIBConverter {
+  BIBConverterFlags flags;
+  BIBConverterEntryFunc func;
+  gpointer user_data;
+  guint jobs;
+  gboolean finished;
+  BIBSplitter splitter;
+  GString *pending;
+  // Keys handed out so far, owned, to drop later duplicates.
+  GHashTable *seen;
+  // Sorted only: the chunks and what was parsed from them.
+  GPtrArray *chunks;
+  BIBEntryList *entries;
+};
+
+BIBConverter *bib_converter_new(BIBConverterFlags flags, BIBConverterEntryFunc func, gpointer user_data) {
+  g_return_val_if_fail(func != NULL, NULL);
+
+  BIBConverter *converter = g_new0(BIBConverter, 1);
+  converter->flags = flags;
+  converter->func = func;
+  converter->user_data = user_data;
+  converter->jobs = 1;
+  converter->pending = g_string_new(NULL);
+  converter->seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  converter->chunks = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+  converter->entries = bib_entry_list_create();
+  return converter;
+}
+
+void bib_converter_set_jobs(BIBConverter *converter, guint jobs) {
+  g_return_if_fail(converter != NULL);
+  converter->jobs = jobs > 0 ? jobs : g_get_num_processors();
+}
+
+static void converter_deliver(BIBConverter *converter, BIBEntry *entry) {
+  if (!g_hash_table_add(converter->seen, g_strndup(entry->key.str, entry->key.len))) {
+    return;
+  }
+
+  BIBOutputFormat format = converter->flags & BIB_CONVERTER_JSON ? BIB_OUTPUT_NDJSON : BIB_OUTPUT_BIB;
+  gboolean bibtex = converter->flags & BIB_CONVERTER_BIBTEX;
+  g_autoptr(GBytes) formatted = bib_entry_format(entry, format, bibtex);
+  gsize length = 0;
+  const gchar *text = g_bytes_get_data(formatted, &length);
+  BIBString type = bibtex ? bib_entry_print_type(entry) : entry->type;
+
+  BIBConverterEntry out = {
+      .type = type.str,
+      .type_length = type.len,
+      .key = entry->key.str,
+      .key_length = entry->key.len,
+      .text = text,
+      .text_length = length - strlen(bib_output_frame(format)->terminator),
+  };
+
+  converter->func(&out, converter->user_data);
+}
+
+// Takes over `chunk`, whose entries are all complete.
+static gboolean converter_convert(BIBConverter *converter, GString *chunk, GError **error) {
+  gsize length = chunk->len;
+  g_autoptr(GBytes) bytes = g_bytes_new_take(g_string_free(chunk, FALSE), length);
+
+  if (converter->flags & BIB_CONVERTER_SORTED) {
+    BIBEntryList *entries = bib_parse_unsorted(bytes, converter->jobs, error);
+
+    if (entries == NULL) {
+      return FALSE;
+    }
+
+    g_ptr_array_extend_and_steal(converter->entries->entries, g_steal_pointer(&entries->entries));
+    g_ptr_array_extend_and_steal(converter->entries->arenas, g_steal_pointer(&entries->arenas));
+    g_free(entries);
+    g_ptr_array_add(converter->chunks, g_steal_pointer(&bytes));
+    return TRUE;
+  }
+
+  g_autoptr(BIBEntryList) entries = bib_parse_unsorted(bytes, converter->jobs, error);
+
+  if (entries == NULL) {
+    return FALSE;
+  }
+
+  for (guint i = 0; i < entries->entries->len; i++) {
+    converter_deliver(converter, g_ptr_array_index(entries->entries, i));
+  }
+
+  return TRUE;
+}
+
+gboolean bib_converter_feed(BIBConverter *converter, const gchar *data, gsize length, GError **error) {
+  g_return_val_if_fail(converter != NULL, FALSE);
+  g_return_val_if_fail(data != NULL || length == 0, FALSE);
+  g_return_val_if_fail(!converter->finished, FALSE);
+
+  g_string_append_len(converter->pending, data, length);
+  bib_splitter_scan(&converter->splitter, converter->pending->str, converter->pending->len);
+
+  if (converter->pending->len < BIB_CONVERTER_CHUNK_SIZE || converter->splitter.boundary == 0) {
+    return TRUE;
+  }
+
+  // As in --stream, the chunk keeps the large buffer and only the incomplete
+  // entry is copied.
+  GString *chunk = converter->pending;
+  gsize boundary = converter->splitter.boundary;
+  converter->pending = g_string_new_len(chunk->str + boundary, chunk->len - boundary);
+  g_string_truncate(chunk, boundary);
+  bib_splitter_consume(&converter->splitter, boundary);
+
+  return converter_convert(converter, chunk, error);
+}
+
+gboolean bib_converter_finish(BIBConverter *converter, GError **error) {
+  g_return_val_if_fail(converter != NULL, FALSE);
+  g_return_val_if_fail(!converter->finished, FALSE);
+
+  converter->finished = TRUE;
+
+  if (!converter_convert(converter, g_steal_pointer(&converter->pending), error)) {
+    return FALSE;
+  }
+
+  if (converter->flags & BIB_CONVERTER_SORTED) {
+    // Stable, so of equal keys the first one fed is the one kept.
+    bib_entry_list_sort(converter->entries, converter->jobs);
+
+    for (guint i = 0; i < converter->entries->entries->len; i++) {
+      converter_deliver(converter, g_ptr_array_index(converter->entries->entries, i));
+    }
+  }
+
+  return TRUE;
+}
+
+void bib_converter_free(BIBConverter *converter) {
+  if (converter == NULL) {
+    return;
+  }
+
+  if (converter->pending != NULL) {
+    g_string_free(converter->pending, TRUE);
+  }
+
+  g_hash_table_unref(converter->seen);
+  bib_entry_list_free(converter->entries);
+  g_ptr_array_unref(converter->chunks);
+  g_free(converter);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+#define BIB_ARENA_BLOCK_SIZE (64 * 1024)
+#define BIB_ARENA_MAX_BLOCK_SIZE (4 * 1024 * 1024)
+#define BIB_ARENA_ALIGN 16
+
+struct BIBArenaBlock {
+  struct BIBArenaBlock *next;
+  gsize size;
+  gsize used;
+  gchar data[];
+};
+
+// Memory is only ever handed out, never returned: everything goes away at once
+// in bib_arena_free. Blocks double in size up to a cap, so a large file ends up
+// with a few hundred blocks rather than millions of small allocations.
+struct BIBArena {
+  struct BIBArenaBlock *head;
+  gsize next_size;
+  gsize blocks;
+  gsize allocated;
+};
+
+BIBArena *bib_arena_new(void) {
+  BIBArena *arena = g_new0(BIBArena, 1);
+  arena->next_size = BIB_ARENA_BLOCK_SIZE;
+  return arena;
+}
+
+static gsize arena_padding(const struct BIBArenaBlock *block) {
+  guintptr position = (guintptr)(block->data + block->used);
+  return (BIB_ARENA_ALIGN - position % BIB_ARENA_ALIGN) % BIB_ARENA_ALIGN;
+}
+
+gpointer bib_arena_alloc(BIBArena *arena, gsize size) {
+  struct BIBArenaBlock *block = arena->head;
+
+  if (block == NULL || block->size - block->used < size + arena_padding(block)) {
+    gsize block_size = MAX(arena->next_size, size + BIB_ARENA_ALIGN);
+    block = g_malloc(sizeof(struct BIBArenaBlock) + block_size);
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+    arena->next_size = MIN(arena->next_size * 2, BIB_ARENA_MAX_BLOCK_SIZE);
+    arena->blocks++;
+    bib_stats_add(arena_blocks, 1);
+    bib_stats_add(arena_bytes, block_size);
+  }
+
+  block->used += arena_padding(block);
+  gpointer ptr = block->data + block->used;
+  block->used += size;
+  arena->allocated += size;
+
+  return ptr;
+}
+
+// Moves an owned string into the arena, so that freeing the arena is enough to
+// release it. Views are returned as they are.
+BIBString bib_arena_string(BIBArena *arena, BIBString string) {
+  if (string.owned == NULL) {
+    return string;
+  }
+
+  gchar *copy = bib_arena_alloc(arena, string.len);
+  memcpy(copy, string.str, string.len);
+  BIBString view = bib_string_view(copy, string.len);
+  view.pending = string.pending;
+  bib_string_clear(&string);
+
+  return view;
+}
+
+void bib_arena_stats(const BIBArena *arena, gsize *blocks, gsize *allocated) {
+  *blocks = arena->blocks;
+  *allocated = arena->allocated;
+}
+
+void bib_arena_free(gpointer ptr) {
+  BIBArena *arena = ptr;
+
+  if (arena == NULL) {
+    return;
+  }
+
+  struct BIBArenaBlock *block = arena->head;
+  while (block != NULL) {
+    struct BIBArenaBlock *next = block->next;
+    g_free(block);
+    block = next;
+  }
+
+  g_free(arena);
+}
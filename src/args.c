@@ -16,13 +16,36 @@
 
 #include "internal.h"
 
-struct options parse_options(int argc, char **argv) {
-  struct options o = {0};
+struct options bib_parse_options(int argc, char **argv) {
+  struct options o = {.jobs = 1, .chunk_size = 64};
 
   GOptionEntry entries[] = {
-      {"bibtex",           'b', 0, G_OPTION_ARG_NONE,           &o.bibtex,  "Output for bibtex instead of biblatex", ""},
-      {"version",          'v', 0, G_OPTION_ARG_NONE,           &o.version, "Show version",                          ""},
-      {G_OPTION_REMAINING, 0,   0, G_OPTION_ARG_FILENAME_ARRAY, &o.rest,    "File",                                  ""},
+      {"bibtex",           'b', 0, G_OPTION_ARG_NONE,           &o.bibtex,       "Output for bibtex instead of biblatex",                                  ""},
+      {"jobs",             'j', 0, G_OPTION_ARG_INT,            &o.jobs,         "Convert using N threads (0 for all cores)",                              "N"},
+      {"stream",           's', 0, G_OPTION_ARG_NONE,           &o.stream,       "Convert in bounded chunks, for inputs larger than memory",               ""},
+      {"chunk-size",       0,   0, G_OPTION_ARG_INT,            &o.chunk_size,   "Chunk size in MiB for --stream (default: 64)",                           "MiB"},
+      {"batch",            0,   0, G_OPTION_ARG_NONE,           &o.batch,        "Convert every file given, writing each output next to it",               ""},
+      {"files-from",       0,   0, G_OPTION_ARG_FILENAME,       &o.files_from,   "Read the files to convert in batch from FILE (- for stdin)",             "FILE"},
+      {"output-dir",       'd', 0, G_OPTION_ARG_FILENAME,       &o.output_dir,   "Write batch outputs into DIR",                                           "DIR"},
+      {"cite",             'c', 0, G_OPTION_ARG_STRING_ARRAY,   &o.cite,         "Only convert the entry with this key (repeatable, comma-separated)",     "KEY"},
+      {"cite-file",        0,   0, G_OPTION_ARG_FILENAME_ARRAY, &o.cite_files,   "Only convert the entries cited in FILE (.aux, .bcf or a list of keys)",  "FILE"},
+      {"cache-dir",        0,   0, G_OPTION_ARG_FILENAME,       &o.cache_dir,    "Keep the parse cache in DIR",                                            "DIR"},
+      {"no-cache",         0,   0, G_OPTION_ARG_NONE,           &o.no_cache,     "Neither read nor write the parse cache",                                 ""},
+      {"output",           'o', 0, G_OPTION_ARG_FILENAME,       &o.output,       "Write the output to FILE instead of stdout",                             "FILE"},
+      {"watch",            'w', 0, G_OPTION_ARG_NONE,           &o.watch,        "Convert again whenever the input changes (requires --output)",           ""},
+      {"daemon",           0,   0, G_OPTION_ARG_NONE,           &o.daemon,       "Serve conversions over a Unix socket",                                   ""},
+      {"client",           0,   0, G_OPTION_ARG_NONE,           &o.client,       "Convert through a running daemon (- reads stdin)",                       ""},
+      {"socket",           0,   0, G_OPTION_ARG_FILENAME,       &o.socket,       "Socket path for --daemon and --client",                                  "PATH"},
+      {"stats",            0,   0, G_OPTION_ARG_NONE,           &o.stats,        "Report timings and counters on stderr",                                  ""},
+      {"stats-json",       0,   0, G_OPTION_ARG_NONE,           &o.stats_json,   "Report timings and counters on stderr as JSON",                          ""},
+      {"merge",            'm', 0, G_OPTION_ARG_NONE,           &o.merge,        "Merge every file given into one output, dropping duplicates",            ""},
+      {"match",            0,   0, G_OPTION_ARG_STRING_ARRAY,   &o.match,        "Also treat entries with the same doi or title as duplicates in --merge", "FIELD"},
+      {"on-conflict",      0,   0, G_OPTION_ARG_STRING,         &o.on_conflict,  "Keep the first or last duplicate, merge their fields, or fail",          "first|last|merge|error"},
+      {"compress",         'z', 0, G_OPTION_ARG_STRING,         &o.compress,     "Compress the output (default: from the extension of --output)",          "none|gzip|zstd"},
+      {"format",           'f', 0, G_OPTION_ARG_STRING,         &o.format,       "Print the entries as .bib, one JSON object per line, or CSL-JSON",       "bib|ndjson|csl"},
+      {"no-fast-scan",     0,   0, G_OPTION_ARG_NONE,           &o.no_fast_scan, "Parse every entry with tree-sitter instead of the fast scanner",         ""},
+      {"version",          'v', 0, G_OPTION_ARG_NONE,           &o.version,      "Show version",                                                           ""},
+      {G_OPTION_REMAINING, 0,   0, G_OPTION_ARG_FILENAME_ARRAY, &o.rest,         "File",                                                                   ""},
       G_OPTION_ENTRY_NULL
   };
 
@@ -38,5 +61,93 @@ struct options parse_options(int argc, char **argv) {
     exit(1);
   }
 
+  if (o.stats_json) {
+    bib_stats_enable(BIB_STATS_JSON);
+  } else if (o.stats) {
+    bib_stats_enable(BIB_STATS_TEXT);
+  }
+
+  bib_parse_set_fast_scan(!o.no_fast_scan);
+
+  if (o.jobs <= 0) {
+    o.jobs = g_get_num_processors();
+  }
+
+  o.merge_match = BIB_MATCH_KEY;
+
+  for (gchar **list = o.match; list != NULL && *list != NULL; list++) {
+    g_auto(GStrv) parts = g_strsplit_set(*list, ", ", -1);
+
+    for (gchar **part = parts; *part != NULL; part++) {
+      if (g_ascii_strcasecmp(*part, "doi") == 0) {
+        o.merge_match |= BIB_MATCH_DOI;
+      } else if (g_ascii_strcasecmp(*part, "title") == 0) {
+        o.merge_match |= BIB_MATCH_TITLE;
+      } else if (g_ascii_strcasecmp(*part, "key") != 0 && **part != '\0') {
+        g_print("option parsing failed: --match takes key, doi or title, not %s\n", *part);
+        exit(1);
+      }
+    }
+  }
+
+  if (o.on_conflict == NULL || g_strcmp0(o.on_conflict, "first") == 0) {
+    o.merge_policy = BIB_MERGE_FIRST;
+  } else if (g_strcmp0(o.on_conflict, "last") == 0) {
+    o.merge_policy = BIB_MERGE_LAST;
+  } else if (g_strcmp0(o.on_conflict, "merge") == 0) {
+    o.merge_policy = BIB_MERGE_FIELDS;
+  } else if (g_strcmp0(o.on_conflict, "error") == 0) {
+    o.merge_policy = BIB_MERGE_ERROR;
+  } else {
+    g_print("option parsing failed: --on-conflict takes first, last, merge or error\n");
+    exit(1);
+  }
+
+  if (!bib_output_format_parse(o.format, &o.output_format)) {
+    g_print("option parsing failed: --format takes bib, ndjson or csl (csl-json)\n");
+    exit(1);
+  }
+
+  if (!bib_compression_parse(o.compress, o.output, &o.compression)) {
+    g_print("option parsing failed: --compress takes none, gzip or zstd\n");
+    exit(1);
+  }
+
+  if (o.watch && o.output == NULL) {
+    g_print("option parsing failed: --watch requires --output\n");
+    exit(1);
+  }
+
+  // Citations and merging only apply to the plain conversion; the other modes
+  // would silently convert every entry, or only the first file.
+  const gchar *mode = NULL;
+
+  if (o.batch || o.files_from != NULL) {
+    mode = "--batch";
+  } else if (o.daemon) {
+    mode = "--daemon";
+  } else if (o.client) {
+    mode = "--client";
+  } else if (o.watch) {
+    mode = "--watch";
+  } else if (o.stream) {
+    mode = "--stream";
+  }
+
+  if (mode != NULL && (o.cite != NULL || o.cite_files != NULL)) {
+    g_print("option parsing failed: --cite and --cite-file cannot be used with %s\n", mode);
+    exit(1);
+  }
+
+  if (mode != NULL && o.merge) {
+    g_print("option parsing failed: --merge cannot be used with %s\n", mode);
+    exit(1);
+  }
+
+  if (o.chunk_size <= 0) {
+    g_print("option parsing failed: --chunk-size must be positive\n");
+    exit(1);
+  }
+
   return o;
 }
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Batch mode converts many files in one process. Files are spread over the
+// worker threads, each of which reuses its parser and the compiled regexes
+// for every file it gets.
+
+struct batch_file {
+  const gchar *path;
+  gchar *output;
+  const struct options *options;
+  gboolean failed;
+};
+
+static gchar *batch_output_path(const gchar *path, const struct options *options) {
+  g_autofree gchar *basename = g_path_get_basename(path);
+  g_autofree gchar *dirname = options->output_dir != NULL ? g_strdup(options->output_dir) : g_path_get_dirname(path);
+
+  // Compressed inputs are read transparently, but outputs are not compressed.
+  if (g_str_has_suffix(basename, ".gz")) {
+    basename[strlen(basename) - strlen(".gz")] = '\0';
+  } else if (g_str_has_suffix(basename, ".zst")) {
+    basename[strlen(basename) - strlen(".zst")] = '\0';
+  }
+
+  if (g_str_has_suffix(basename, ".bib")) {
+    basename[strlen(basename) - strlen(".bib")] = '\0';
+  }
+
+  const gchar *extension = options->bibtex ? ".bibtex.bib" : ".biblatex.bib";
+
+  if (options->output_format == BIB_OUTPUT_NDJSON) {
+    extension = ".ndjson";
+  } else if (options->output_format == BIB_OUTPUT_CSL) {
+    extension = ".csl.json";
+  }
+
+  g_autofree gchar *name = g_strconcat(basename, extension, NULL);
+  return g_build_filename(dirname, name, NULL);
+}
+
+static void batch_convert_file(gpointer data, gpointer user_data) {
+  struct batch_file *file = data;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GBytes) contents = bib_file_read(file->path, &error);
+
+  if (error != NULL) {
+    g_printerr("%s: Error reading file: %s\n", file->path, error->message);
+    file->failed = TRUE;
+    return;
+  }
+
+  g_autoptr(BIBEntryList) entries = bib_parse(contents, 1, &error);
+
+  if (error != NULL) {
+    g_printerr("%s: Error: %s\n", file->path, error->message);
+    file->failed = TRUE;
+    return;
+  }
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+  BIBSink *sink = bib_sink_new();
+  bib_entry_list_print(sink, entries, file->options->output_format, file->options->bibtex, 1);
+
+  if (file->options->output_format == BIB_OUTPUT_BIB) {
+    bib_sink_append(sink, "\n", 1);
+  }
+  g_autoptr(GBytes) formatted = bib_sink_free_to_bytes(sink);
+  bib_stats_stop(&timer, BIB_PHASE_PRINT);
+  gsize length = 0;
+  const gchar *text = g_bytes_get_data(formatted, &length);
+
+  if (!g_file_set_contents(file->output, text, length, &error)) {
+    g_printerr("%s: Error writing file: %s\n", file->output, error->message);
+    file->failed = TRUE;
+    return;
+  }
+
+  bib_stats_add(bytes_out, length);
+}
+
+// Reads one path per line, "-" meaning standard input.
+static GPtrArray *batch_read_list(const gchar *list, GError **error) {
+  g_autoptr(GString) contents = g_string_new(NULL);
+
+  if (g_strcmp0(list, "-") == 0) {
+    gchar buffer[4096];
+    gsize length;
+    while ((length = fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+      g_string_append_len(contents, buffer, length);
+    }
+  } else {
+    g_autoptr(GBytes) bytes = bib_file_read(list, error);
+    if (bytes == NULL) {
+      return NULL;
+    }
+    gsize length = 0;
+    const gchar *data = g_bytes_get_data(bytes, &length);
+    g_string_append_len(contents, data, length);
+  }
+
+  GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+  g_auto(GStrv) lines = g_strsplit_set(contents->str, "\r\n", -1);
+
+  for (gchar **line = lines; *line != NULL; line++) {
+    g_strstrip(*line);
+    if (**line != '\0') {
+      g_ptr_array_add(paths, g_strdup(*line));
+    }
+  }
+
+  return paths;
+}
+
+gboolean bib_batch_convert(const struct options *options) {
+  g_autoptr(GPtrArray) paths = NULL;
+  g_autoptr(GError) error = NULL;
+
+  if (options->files_from != NULL) {
+    paths = batch_read_list(options->files_from, &error);
+    if (paths == NULL) {
+      g_printerr("Error reading file list: %s\n", error->message);
+      return FALSE;
+    }
+  } else {
+    paths = g_ptr_array_new_with_free_func(g_free);
+  }
+
+  for (gchar **path = options->rest; path != NULL && *path != NULL; path++) {
+    g_ptr_array_add(paths, g_strdup(*path));
+  }
+
+  if (options->output_dir != NULL && g_mkdir_with_parents(options->output_dir, 0755) != 0) {
+    g_printerr("Could not create output directory %s\n", options->output_dir);
+    return FALSE;
+  }
+
+  g_autofree struct batch_file *files = g_new0(struct batch_file, paths->len);
+  // With --output-dir, files of the same name from different directories
+  // would be written to the same output, from different threads. Nothing is
+  // converted then.
+  g_autoptr(GHashTable) outputs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  gboolean ok = TRUE;
+
+  for (guint i = 0; i < paths->len; i++) {
+    files[i].path = g_ptr_array_index(paths, i);
+    files[i].output = batch_output_path(files[i].path, options);
+    files[i].options = options;
+
+    const gchar *other = g_hash_table_lookup(outputs, files[i].output);
+
+    if (other != NULL) {
+      g_printerr("%s: Output %s is also the output of %s\n", files[i].path, files[i].output, other);
+      ok = FALSE;
+    } else {
+      g_hash_table_insert(outputs, g_strdup(files[i].output), (gpointer)files[i].path);
+    }
+  }
+
+  if (ok) {
+    bib_parallel_for(files, paths->len, sizeof(*files), batch_convert_file, NULL, options->jobs);
+  }
+
+  for (guint i = 0; i < paths->len; i++) {
+    ok = ok && !files[i].failed;
+    g_free(files[i].output);
+  }
+
+  return ok;
+}
@@ -16,27 +16,130 @@
 
 #include "internal.h"
 
-BIBEntry *bib_entry_create(void) {
-  BIBEntry *entry = g_malloc(sizeof(BIBEntry));
-  entry->key = NULL;
-  entry->type = NULL;
-  entry->properties = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+#include <string.h>
+
+#define BIB_ENTRY_FIELDS 8
+#define BIB_ENTRY_INDEX_MIN 32
+
+BIBEntry *bib_entry_create(BIBArena *arena) {
+  BIBEntry *entry = bib_arena_alloc(arena, sizeof(BIBEntry));
+  entry->type = bib_string_literal("");
+  entry->key = bib_string_literal("");
+  entry->fields = bib_arena_alloc(arena, sizeof(BIBField) * BIB_ENTRY_FIELDS);
+  entry->n_fields = 0;
+  entry->capacity = BIB_ENTRY_FIELDS;
+  entry->index = NULL;
+  entry->index_size = 0;
+  entry->indexed = 0;
+  entry->arena = arena;
   return entry;
 }
 
 BIBEntryList *bib_entry_list_create(void) {
-  return g_ptr_array_new_with_free_func(bib_entry_free);
+  BIBEntryList *list = g_new(BIBEntryList, 1);
+  list->entries = g_ptr_array_new();
+  list->arenas = g_ptr_array_new_with_free_func(bib_arena_free);
+  return list;
+}
+
+void bib_entry_list_add_arena(BIBEntryList *list, BIBArena *arena) {
+  g_ptr_array_add(list->arenas, arena);
+}
+
+// Fields are looked up by walking the array, which is all it takes for the
+// few fields real entries have. Past BIB_ENTRY_INDEX_MIN fields, which only
+// broken or hostile input has, setting each field would make parsing
+// quadratic, so the entry gets an open-addressing index of positions + 1,
+// kept at most half full. It catches up with fields added without it, as the
+// cache loader does, but only bib_entry_set builds it: lookups from the
+// printing threads must not allocate from the arena.
+
+static guint *entry_index_slot(const BIBEntry *entry, guint id) {
+  guint mask = entry->index_size - 1;
+  guint slot = (id * 2654435761u) & mask;
+
+  while (entry->index[slot] != 0 && entry->fields[entry->index[slot] - 1].id != id) {
+    slot = (slot + 1) & mask;
+  }
+
+  return &entry->index[slot];
+}
+
+static void entry_index_update(BIBEntry *entry) {
+  if (entry->n_fields < BIB_ENTRY_INDEX_MIN) {
+    return;
+  }
+
+  if (entry->index_size < entry->n_fields * 2) {
+    guint size = MAX(entry->index_size, BIB_ENTRY_INDEX_MIN * 2);
+    while (size < entry->n_fields * 4) {
+      size *= 2;
+    }
+
+    entry->index = bib_arena_alloc(entry->arena, sizeof(guint) * size);
+    memset(entry->index, 0, sizeof(guint) * size);
+    entry->index_size = size;
+    entry->indexed = 0;
+  }
+
+  for (; entry->indexed < entry->n_fields; entry->indexed++) {
+    guint *slot = entry_index_slot(entry, entry->fields[entry->indexed].id);
+    if (*slot == 0) {
+      *slot = entry->indexed + 1;
+    }
+  }
+}
+
+static BIBField *entry_find(const BIBEntry *entry, guint id) {
+  if (entry->index != NULL && entry->indexed == entry->n_fields) {
+    guint position = *entry_index_slot(entry, id);
+    return position > 0 ? &entry->fields[position - 1] : NULL;
+  }
+
+  for (guint i = 0; i < entry->n_fields; i++) {
+    if (entry->fields[i].id == id) {
+      return &entry->fields[i];
+    }
+  }
+
+  return NULL;
+}
+
+void bib_entry_set(BIBEntry *entry, guint id, BIBString value) {
+  value = bib_arena_string(entry->arena, value);
+  entry_index_update(entry);
+
+  BIBField *field = entry_find(entry, id);
+
+  if (field != NULL) {
+    field->value = value;
+    return;
+  }
+
+  // The old array stays in the arena; entries rarely outgrow the first one.
+  if (entry->n_fields == entry->capacity) {
+    BIBField *fields = bib_arena_alloc(entry->arena, sizeof(BIBField) * entry->capacity * 2);
+    memcpy(fields, entry->fields, sizeof(BIBField) * entry->n_fields);
+    entry->fields = fields;
+    entry->capacity *= 2;
+  }
+
+  BIBField added = {.id = id, .value = value};
+  entry->fields[entry->n_fields++] = added;
+  entry_index_update(entry);
 }
 
-void bib_entry_free(gpointer ptr) {
-  BIBEntry *entry = ptr;
-  g_free(entry->key);
-  g_free(entry->type);
-  g_hash_table_destroy(entry->properties);
-  g_free(entry);
+const BIBString *bib_entry_get(BIBEntry *entry, guint id) {
+  BIBField *field = entry_find(entry, id);
+  return field != NULL ? &field->value : NULL;
 }
 
-void bib_entry_list_free(gpointer list) {
-  g_ptr_array_set_free_func(list, bib_entry_free);
-  g_ptr_array_free(list, TRUE);
+void bib_entry_list_free(gpointer ptr) {
+  BIBEntryList *list = ptr;
+  if (list == NULL) {
+    return;
+  }
+  g_ptr_array_unref(list->entries);
+  g_ptr_array_unref(list->arenas);
+  g_free(list);
 }
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+// On-disk cache of parsed entry lists, named after a hash of the input bytes,
+// the tool version, the cache format and the mapping tables. The file is
+// memory-mapped on load and the entries point straight into the mapping, so a
+// warm run neither parses nor copies.
+//
+// BIB_CACHE_FORMAT must be bumped whenever the layout, or what parsing makes
+// of an entry outside of the mapping tables, changes. Each save prunes the
+// directory: files older than BIB_CACHE_MAX_AGE go, then the oldest ones until
+// the rest fit in BIB_CACHE_MAX_SIZE.
+//
+// Field names are stored as text, since the IDs of names outside the known
+// set depend on the order they were interned in.
+//
+// Layout, in host byte order:
+//   header:  magic "BIBCACHE", u32 format, u32 byte order mark, u64 entries
+//   entry:   string type, string key, u32 field count, fields
+//   field:   string name, string value (already normalized)
+//   string:  u32 length, bytes
+
+#define BIB_CACHE_MAGIC "BIBCACHE"
+#define BIB_CACHE_FORMAT 2
+#define BIB_CACHE_BYTE_ORDER 0x01020304
+#define BIB_CACHE_MAX_AGE (30 * G_TIME_SPAN_DAY)
+#define BIB_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+struct cache_header {
+  gchar magic[8];
+  guint32 format;
+  guint32 byte_order;
+  guint64 count;
+};
+
+struct cache_reader {
+  const gchar *data;
+  gsize length;
+  gsize position;
+};
+
+gchar *bib_cache_path(const gchar *dir, GBytes *contents) {
+  static const gchar *path = "/me/acristoffers/remove-trash/version";
+  g_autoptr(GBytes) version = g_resources_lookup_data(path, G_RESOURCE_LOOKUP_FLAGS_NONE, NULL);
+  g_autoptr(GChecksum) checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  guint32 format = BIB_CACHE_FORMAT;
+  gsize length = 0;
+  const guchar *data = g_bytes_get_data(contents, &length);
+
+  if (version != NULL) {
+    gsize version_length = 0;
+    const guchar *version_data = g_bytes_get_data(version, &version_length);
+    g_checksum_update(checksum, version_data, version_length);
+  }
+
+  g_checksum_update(checksum, (const guchar *)&format, sizeof(format));
+  g_checksum_update(checksum, (const guchar *)BIB_MAPPINGS_HASH, strlen(BIB_MAPPINGS_HASH));
+  g_checksum_update(checksum, data, length);
+
+  g_autofree gchar *name = g_strconcat(g_checksum_get_string(checksum), ".bibcache", NULL);
+
+  if (dir != NULL) {
+    return g_build_filename(dir, name, NULL);
+  }
+
+  return g_build_filename(g_get_user_cache_dir(), "bib-converter", name, NULL);
+}
+
+static gboolean cache_read(struct cache_reader *reader, gpointer value, gsize size) {
+  if (reader->length - reader->position < size) {
+    return FALSE;
+  }
+
+  memcpy(value, reader->data + reader->position, size);
+  reader->position += size;
+  return TRUE;
+}
+
+static gboolean cache_read_string(struct cache_reader *reader, BIBString *string) {
+  guint32 length = 0;
+
+  if (!cache_read(reader, &length, sizeof(length)) || reader->length - reader->position < length) {
+    return FALSE;
+  }
+
+  *string = bib_string_view(reader->data + reader->position, length);
+  reader->position += length;
+  return TRUE;
+}
+
+static BIBEntry *cache_read_entry(struct cache_reader *reader, BIBArena *arena) {
+  BIBEntry *entry = bib_entry_create(arena);
+  guint32 count = 0;
+
+  if (!cache_read_string(reader, &entry->type) ||
+      !cache_read_string(reader, &entry->key) ||
+      !cache_read(reader, &count, sizeof(count)) ||
+      count > (reader->length - reader->position) / (2 * sizeof(guint32))) {
+    return NULL;
+  }
+
+  if (count > entry->capacity) {
+    entry->fields = bib_arena_alloc(arena, sizeof(BIBField) * count);
+    entry->capacity = count;
+  }
+
+  for (guint32 i = 0; i < count; i++) {
+    BIBField *field = &entry->fields[i];
+    *field = (BIBField){0};
+
+    BIBString name = {0};
+
+    if (!cache_read_string(reader, &name) || !cache_read_string(reader, &field->value)) {
+      return NULL;
+    }
+
+    field->id = bib_field_intern(&name);
+
+    entry->n_fields++;
+  }
+
+  return entry;
+}
+
+// The returned entries point into `cache`, which must outlive them.
+BIBEntryList *bib_cache_load(GBytes *cache, GError **error) {
+  struct cache_reader reader = {0};
+  struct cache_header header = {0};
+  reader.data = g_bytes_get_data(cache, &reader.length);
+
+  if (!cache_read(&reader, &header, sizeof(header)) ||
+      memcmp(header.magic, BIB_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.format != BIB_CACHE_FORMAT ||
+      header.byte_order != BIB_CACHE_BYTE_ORDER) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Invalid cache file");
+    return NULL;
+  }
+
+  g_autoptr(BIBEntryList) entries = bib_entry_list_create();
+  BIBArena *arena = bib_arena_new();
+  bib_entry_list_add_arena(entries, arena);
+
+  for (guint64 i = 0; i < header.count; i++) {
+    BIBEntry *entry = cache_read_entry(&reader, arena);
+
+    if (entry == NULL) {
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated cache file");
+      return NULL;
+    }
+
+    g_ptr_array_add(entries->entries, entry);
+  }
+
+  return g_steal_pointer(&entries);
+}
+
+static gboolean cache_write_string(GString *out, const BIBString *string, GError **error) {
+  guint32 length = string->len;
+
+  if (string->len > G_MAXUINT32) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "String too long to cache");
+    return FALSE;
+  }
+
+  g_string_append_len(out, (const gchar *)&length, sizeof(length));
+  g_string_append_len(out, string->str, string->len);
+  return TRUE;
+}
+
+struct cache_file {
+  gchar *path;
+  gint64 modified;
+  goffset size;
+};
+
+static void cache_file_clear(gpointer data) {
+  g_free(((struct cache_file *)data)->path);
+}
+
+static gint cache_file_compare(gconstpointer a, gconstpointer b) {
+  gint64 modified_a = ((const struct cache_file *)a)->modified;
+  gint64 modified_b = ((const struct cache_file *)b)->modified;
+  return (modified_a > modified_b) - (modified_a < modified_b);
+}
+
+// Failures are ignored: another process may be pruning the same directory.
+static void cache_prune(const gchar *dir) {
+  g_autoptr(GDir) handle = g_dir_open(dir, 0, NULL);
+
+  if (handle == NULL) {
+    return;
+  }
+
+  g_autoptr(GArray) files = g_array_new(FALSE, FALSE, sizeof(struct cache_file));
+  g_array_set_clear_func(files, cache_file_clear);
+  gint64 now = g_get_real_time();
+  goffset total = 0;
+  const gchar *name = NULL;
+
+  while ((name = g_dir_read_name(handle)) != NULL) {
+    if (!g_str_has_suffix(name, ".bibcache")) {
+      continue;
+    }
+
+    g_autofree gchar *path = g_build_filename(dir, name, NULL);
+    GStatBuf info;
+
+    if (g_stat(path, &info) != 0) {
+      continue;
+    }
+
+    struct cache_file file = {.modified = (gint64)info.st_mtime * G_USEC_PER_SEC, .size = info.st_size};
+
+    if (now - file.modified > BIB_CACHE_MAX_AGE) {
+      g_unlink(path);
+      continue;
+    }
+
+    file.path = g_steal_pointer(&path);
+    g_array_append_val(files, file);
+    total += file.size;
+  }
+
+  g_array_sort(files, cache_file_compare);
+
+  // The newest, the one just saved, stays whatever its size.
+  for (guint i = 0; i + 1 < files->len && total > BIB_CACHE_MAX_SIZE; i++) {
+    struct cache_file *file = &g_array_index(files, struct cache_file, i);
+    g_unlink(file->path);
+    total -= file->size;
+  }
+}
+
+gboolean bib_cache_save(const gchar *path, BIBEntryList *list, GError **error) {
+  GPtrArray *entries = list->entries;
+  struct cache_header header = {.format = BIB_CACHE_FORMAT, .byte_order = BIB_CACHE_BYTE_ORDER, .count = entries->len};
+  memcpy(header.magic, BIB_CACHE_MAGIC, sizeof(header.magic));
+
+  g_autoptr(GString) out = g_string_sized_new(sizeof(header) + entries->len * 80 * 7);
+  g_string_append_len(out, (const gchar *)&header, sizeof(header));
+
+  for (guint i = 0; i < entries->len; i++) {
+    BIBEntry *entry = g_ptr_array_index(entries, i);
+    guint32 count = entry->n_fields;
+
+    if (!cache_write_string(out, &entry->type, error) || !cache_write_string(out, &entry->key, error)) {
+      return FALSE;
+    }
+
+    g_string_append_len(out, (const gchar *)&count, sizeof(count));
+
+    for (guint j = 0; j < entry->n_fields; j++) {
+      BIBField *field = &entry->fields[j];
+      g_auto(BIBString) value = bib_string_resolve(&field->value);
+
+      if (!cache_write_string(out, bib_field_name(field->id), error) || !cache_write_string(out, &value, error)) {
+        return FALSE;
+      }
+    }
+  }
+
+  g_autofree gchar *dir = g_path_get_dirname(path);
+
+  if (g_mkdir_with_parents(dir, 0755) != 0) {
+    int saved_errno = errno;
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno), "%s: %s", dir, g_strerror(saved_errno));
+    return FALSE;
+  }
+
+  if (!g_file_set_contents(path, out->str, out->len, error)) {
+    return FALSE;
+  }
+
+  cache_prune(dir);
+  return TRUE;
+}
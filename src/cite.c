@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+// Collects the citation keys to extract. Keys are lowercased, like the keys
+// of parsed entries. A "*" key (from \nocite{*}) means every entry.
+
+static void cite_add_list(GHashTable *keys, const gchar *list) {
+  g_auto(GStrv) parts = g_strsplit_set(list, ", \t\r\n", -1);
+
+  for (gchar **part = parts; *part != NULL; part++) {
+    if (**part != '\0') {
+      g_hash_table_add(keys, g_utf8_strdown(*part, -1));
+    }
+  }
+}
+
+static void cite_add_matches(GHashTable *keys, const gchar *pattern, const gchar *text, gsize length) {
+  g_autoptr(GRegex) regex = g_regex_new(pattern, G_REGEX_OPTIMIZE, G_REGEX_MATCH_DEFAULT, NULL);
+  g_autoptr(GMatchInfo) match_info = NULL;
+
+  g_regex_match_full(regex, text, length, 0, G_REGEX_MATCH_DEFAULT, &match_info, NULL);
+
+  while (g_match_info_matches(match_info)) {
+    g_autofree gchar *list = g_match_info_fetch_named(match_info, "keys");
+    cite_add_list(keys, list);
+    g_match_info_next(match_info, NULL);
+  }
+}
+
+static gboolean cite_add_file(GHashTable *keys, const gchar *path, GError **error) {
+  g_autoptr(GBytes) contents = bib_file_read(path, error);
+
+  if (contents == NULL) {
+    return FALSE;
+  }
+
+  gsize length = 0;
+  const gchar *text = g_bytes_get_data(contents, &length);
+
+  if (g_str_has_suffix(path, ".aux")) {
+    // bibtex writes \citation{a,b}, biblatex \abx@aux@cite{a} or, since
+    // 3.13, \abx@aux@cite{refsection}{a}.
+    cite_add_matches(keys, "\\\\citation\\{(?<keys>[^}]*)\\}", text, length);
+    cite_add_matches(keys, "\\\\abx@aux@cite(?:\\{[^}]*\\}(?=\\{))?\\{(?<keys>[^}]*)\\}", text, length);
+  } else if (g_str_has_suffix(path, ".bcf")) {
+    cite_add_matches(keys, "<bcf:citekey[^>]*>(?<keys>[^<]*)</bcf:citekey>", text, length);
+  } else {
+    g_autofree gchar *list = g_strndup(text, length);
+    cite_add_list(keys, list);
+  }
+
+  return TRUE;
+}
+
+GHashTable *bib_cite_keys(gchar **keys, gchar **files, GError **error) {
+  g_autoptr(GHashTable) set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (gchar **key = keys; key != NULL && *key != NULL; key++) {
+    cite_add_list(set, *key);
+  }
+
+  for (gchar **file = files; file != NULL && *file != NULL; file++) {
+    if (!cite_add_file(set, *file, error)) {
+      return NULL;
+    }
+  }
+
+  return g_steal_pointer(&set);
+}
+
+// Moves the cited entries of an already parsed list into a new list, for
+// inputs that did not go through bib_parse_cited (e.g. cache hits).
+BIBEntryList *bib_entry_list_cited(BIBEntryList *list, GHashTable *keys) {
+  gboolean all = g_hash_table_contains(keys, "*");
+  g_autoptr(GHashTable) found = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  BIBEntryList *cited = bib_entry_list_create();
+
+  for (guint i = 0; i < list->entries->len; i++) {
+    BIBEntry *entry = g_ptr_array_index(list->entries, i);
+    g_autofree gchar *key = g_utf8_strdown(entry->key.str, entry->key.len);
+
+    if (all || g_hash_table_contains(keys, key)) {
+      g_ptr_array_add(cited->entries, entry);
+      g_hash_table_add(found, g_steal_pointer(&key));
+    }
+  }
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, keys);
+  while (!all && g_hash_table_iter_next(&iter, &key, NULL)) {
+    if (!g_hash_table_contains(found, key)) {
+      g_printerr("Citation key %s not found\n", (gchar *)key);
+    }
+  }
+
+  // The cited entries still live in the arenas of the original list.
+  g_ptr_array_extend_and_steal(cited->arenas, g_steal_pointer(&list->arenas));
+  list->arenas = g_ptr_array_new_with_free_func(bib_arena_free);
+
+  return cited;
+}
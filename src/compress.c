@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Compressed input is recognized by its magic bytes, whatever the file is
+// called, and decompressed while it is read. Compression goes through
+// GConverter streams: gzip uses GIO's zlib converters, zstd a converter of our
+// own, which is only built when libzstd is available.
+
+static const guint8 gzip_magic[] = {0x1f, 0x8b};
+static const guint8 zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+#ifdef HAVE_ZSTD
+
+#define BIB_TYPE_ZSTD_CONVERTER (bib_zstd_converter_get_type())
+G_DECLARE_FINAL_TYPE(BIBZstdConverter, bib_zstd_converter, BIB, ZSTD_CONVERTER, GObject)
+
+struct _BIBZstdConverter {
+  GObject parent;
+  ZSTD_CCtx *cctx;
+  ZSTD_DCtx *dctx;
+  // Decompressing: the last call ended a frame and consumed all its input.
+  gboolean frame_ended;
+};
+
+static void bib_zstd_converter_iface_init(GConverterIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(BIBZstdConverter, bib_zstd_converter, G_TYPE_OBJECT, G_IMPLEMENT_INTERFACE(G_TYPE_CONVERTER, bib_zstd_converter_iface_init))
+
+static void bib_zstd_converter_finalize(GObject *object) {
+  BIBZstdConverter *self = BIB_ZSTD_CONVERTER(object);
+  ZSTD_freeCCtx(self->cctx);
+  ZSTD_freeDCtx(self->dctx);
+  G_OBJECT_CLASS(bib_zstd_converter_parent_class)->finalize(object);
+}
+
+static void bib_zstd_converter_class_init(BIBZstdConverterClass *klass) {
+  G_OBJECT_CLASS(klass)->finalize = bib_zstd_converter_finalize;
+}
+
+static void bib_zstd_converter_init(BIBZstdConverter *self) {
+}
+
+static GConverterResult bib_zstd_converter_convert(GConverter *converter, const void *inbuf, gsize inbuf_size, void *outbuf, gsize outbuf_size, GConverterFlags flags, gsize *bytes_read, gsize *bytes_written, GError **error) {
+  BIBZstdConverter *self = BIB_ZSTD_CONVERTER(converter);
+  ZSTD_inBuffer in = {inbuf, inbuf_size, 0};
+  ZSTD_outBuffer out = {outbuf, outbuf_size, 0};
+  gboolean at_end = (flags & G_CONVERTER_INPUT_AT_END) != 0;
+  GConverterResult result = G_CONVERTER_CONVERTED;
+  size_t ret;
+
+  if (self->cctx != NULL) {
+    ZSTD_EndDirective mode = at_end ? ZSTD_e_end : (flags & G_CONVERTER_FLUSH) ? ZSTD_e_flush : ZSTD_e_continue;
+    ret = ZSTD_compressStream2(self->cctx, &out, &in, mode);
+
+    // 0 means the frame is complete, or everything was flushed.
+    if (!ZSTD_isError(ret) && ret == 0 && in.pos == in.size && mode != ZSTD_e_continue) {
+      result = mode == ZSTD_e_end ? G_CONVERTER_FINISHED : G_CONVERTER_FLUSHED;
+    }
+  } else if (at_end && inbuf_size == 0 && self->frame_ended) {
+    // The input ended right after a frame, on a call before this one. Asked
+    // again, zstd would hint at the header of a next frame rather than 0.
+    *bytes_read = 0;
+    *bytes_written = 0;
+    return G_CONVERTER_FINISHED;
+  } else {
+    ret = ZSTD_decompressStream(self->dctx, &out, &in);
+
+    // 0 means a frame ended, which is the end when no input follows it.
+    self->frame_ended = !ZSTD_isError(ret) && ret == 0 && in.pos == in.size;
+
+    if (self->frame_ended && at_end) {
+      result = G_CONVERTER_FINISHED;
+    }
+  }
+
+  if (ZSTD_isError(ret)) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "zstd: %s", ZSTD_getErrorName(ret));
+    return G_CONVERTER_ERROR;
+  }
+
+  *bytes_read = in.pos;
+  *bytes_written = out.pos;
+
+  if (result == G_CONVERTER_CONVERTED && in.pos == 0 && out.pos == 0) {
+    // zstd buffers any input it is given, so no progress means either that
+    // the output is full or that more input is needed.
+    if (inbuf_size > 0) {
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Output buffer too small");
+    } else {
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Truncated zstd input");
+    }
+    return G_CONVERTER_ERROR;
+  }
+
+  return result;
+}
+
+static void bib_zstd_converter_reset(GConverter *converter) {
+  BIBZstdConverter *self = BIB_ZSTD_CONVERTER(converter);
+
+  if (self->cctx != NULL) {
+    ZSTD_CCtx_reset(self->cctx, ZSTD_reset_session_only);
+  } else {
+    ZSTD_DCtx_reset(self->dctx, ZSTD_reset_session_only);
+    self->frame_ended = FALSE;
+  }
+}
+
+static void bib_zstd_converter_iface_init(GConverterIface *iface) {
+  iface->convert = bib_zstd_converter_convert;
+  iface->reset = bib_zstd_converter_reset;
+}
+
+#endif
+
+BIBCompression bib_compression_detect(const guint8 *data, gsize length) {
+  if (length >= sizeof(gzip_magic) && memcmp(data, gzip_magic, sizeof(gzip_magic)) == 0) {
+    return BIB_COMPRESSION_GZIP;
+  }
+
+  if (length >= sizeof(zstd_magic) && memcmp(data, zstd_magic, sizeof(zstd_magic)) == 0) {
+    return BIB_COMPRESSION_ZSTD;
+  }
+
+  return BIB_COMPRESSION_NONE;
+}
+
+// Picks the compression from a name given on the command line, or, for
+// `name` NULL, from the extension of the output file.
+gboolean bib_compression_parse(const gchar *name, const gchar *output, BIBCompression *compression) {
+  if (name == NULL) {
+    if (output != NULL && g_str_has_suffix(output, ".gz")) {
+      *compression = BIB_COMPRESSION_GZIP;
+    } else if (output != NULL && g_str_has_suffix(output, ".zst")) {
+      *compression = BIB_COMPRESSION_ZSTD;
+    } else {
+      *compression = BIB_COMPRESSION_NONE;
+    }
+    return TRUE;
+  }
+
+  if (g_strcmp0(name, "none") == 0) {
+    *compression = BIB_COMPRESSION_NONE;
+  } else if (g_strcmp0(name, "gzip") == 0) {
+    *compression = BIB_COMPRESSION_GZIP;
+  } else if (g_strcmp0(name, "zstd") == 0) {
+    *compression = BIB_COMPRESSION_ZSTD;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GConverter *compression_converter(BIBCompression compression, gboolean compress, GError **error) {
+  switch (compression) {
+  case BIB_COMPRESSION_GZIP:
+    if (compress) {
+      return G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+    }
+    return G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+  case BIB_COMPRESSION_ZSTD: {
+#ifdef HAVE_ZSTD
+    BIBZstdConverter *converter = g_object_new(BIB_TYPE_ZSTD_CONVERTER, NULL);
+    if (compress) {
+      converter->cctx = ZSTD_createCCtx();
+    } else {
+      converter->dctx = ZSTD_createDCtx();
+    }
+    return G_CONVERTER(converter);
+#else
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Built without zstd support");
+    return NULL;
+#endif
+  }
+  default:
+    return NULL;
+  }
+}
+
+// Returns a stream that reads `in` decompressed if it starts with the magic
+// bytes of a known format, or as it is otherwise.
+GInputStream *bib_decompress_input(GInputStream *in, GError **error) {
+  g_autoptr(GInputStream) buffered = g_buffered_input_stream_new(in);
+  GBufferedInputStream *peek = G_BUFFERED_INPUT_STREAM(buffered);
+
+  // Pipes may hand out fewer bytes than asked for.
+  while (g_buffered_input_stream_get_available(peek) < sizeof(zstd_magic)) {
+    gssize length = g_buffered_input_stream_fill(peek, sizeof(zstd_magic) - g_buffered_input_stream_get_available(peek), NULL, error);
+
+    if (length < 0) {
+      return NULL;
+    }
+
+    if (length == 0) {
+      break;
+    }
+  }
+
+  gsize length = 0;
+  const guint8 *head = g_buffered_input_stream_peek_buffer(peek, &length);
+  BIBCompression compression = bib_compression_detect(head, length);
+
+  if (compression == BIB_COMPRESSION_NONE) {
+    return g_steal_pointer(&buffered);
+  }
+
+  g_autoptr(GConverter) converter = compression_converter(compression, FALSE, error);
+
+  if (converter == NULL) {
+    return NULL;
+  }
+
+  return g_converter_input_stream_new(buffered, converter);
+}
+
+// Returns a stream that compresses into `out`, or `out` itself for
+// BIB_COMPRESSION_NONE.
+GOutputStream *bib_compress_output(GOutputStream *out, BIBCompression compression, GError **error) {
+  if (compression == BIB_COMPRESSION_NONE) {
+    return g_object_ref(out);
+  }
+
+  g_autoptr(GConverter) converter = compression_converter(compression, TRUE, error);
+
+  if (converter == NULL) {
+    return NULL;
+  }
+
+  return g_converter_output_stream_new(out, converter);
+}
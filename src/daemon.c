@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// A resident process that converts on behalf of short-lived clients, so they
+// pay for neither startup nor parser and regex setup. Each connection is
+// served by a thread of the service, which keeps its parser between requests.
+//
+// Both directions use the same framing: a flag byte, the payload length as a
+// big-endian u64, then the payload. Requests carry the input and the
+// BIB_DAEMON_BIBTEX and output format flags; responses carry the output, or an
+// error message along with BIB_DAEMON_ERROR.
+
+#define BIB_DAEMON_BIBTEX 0x01
+#define BIB_DAEMON_NDJSON 0x02
+#define BIB_DAEMON_CSL 0x04
+#define BIB_DAEMON_ERROR 0x01
+#define BIB_DAEMON_HEADER_SIZE 9
+
+// Requests come from any local process, so their size is capped before the
+// payload is allocated. Responses are trusted.
+#define BIB_DAEMON_MAX_REQUEST ((guint64)1 << 30)
+
+static gchar *daemon_socket_path(const gchar *path) {
+  if (path != NULL) {
+    return g_strdup(path);
+  }
+
+  return g_build_filename(g_get_user_runtime_dir(), "bib-converter.sock", NULL);
+}
+
+// Sets `*payload` to NULL when the peer closed the connection cleanly.
+static gboolean daemon_read(GInputStream *in, guint64 max_length, guint8 *flags, GBytes **payload, GError **error) {
+  guint8 header[BIB_DAEMON_HEADER_SIZE];
+  guint64 length = 0;
+  gsize read = 0;
+
+  *payload = NULL;
+
+  if (!g_input_stream_read_all(in, header, sizeof(header), &read, NULL, error)) {
+    return FALSE;
+  }
+
+  if (read == 0) {
+    return TRUE;
+  }
+
+  if (read < sizeof(header)) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated message header");
+    return FALSE;
+  }
+
+  *flags = header[0];
+  memcpy(&length, header + 1, sizeof(length));
+  length = GUINT64_FROM_BE(length);
+
+  if (length > max_length) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE, "Message too large: %" G_GUINT64_FORMAT " bytes, at most %" G_GUINT64_FORMAT, length, max_length);
+    return FALSE;
+  }
+
+  gchar *data = g_try_malloc(MAX(length, 1));
+
+  if (data == NULL) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NO_SPACE, "Message too large");
+    return FALSE;
+  }
+
+  if (!g_input_stream_read_all(in, data, length, &read, NULL, error) || read < length) {
+    if (read < length && (error == NULL || *error == NULL)) {
+      g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated message");
+    }
+    g_free(data);
+    return FALSE;
+  }
+
+  *payload = g_bytes_new_take(data, length);
+  return TRUE;
+}
+
+static gboolean daemon_write(GOutputStream *out, guint8 flags, const gchar *data, gsize length, GError **error) {
+  guint8 header[BIB_DAEMON_HEADER_SIZE] = {flags};
+  guint64 be_length = GUINT64_TO_BE(length);
+  memcpy(header + 1, &be_length, sizeof(be_length));
+
+  return g_output_stream_write_all(out, header, sizeof(header), NULL, NULL, error) &&
+         g_output_stream_write_all(out, data, length, NULL, NULL, error) &&
+         g_output_stream_flush(out, NULL, error);
+}
+
+static gboolean daemon_run(GThreadedSocketService *service, GSocketConnection *connection, GObject *source_object, gpointer user_data) {
+  GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+  GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+  while (TRUE) {
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GBytes) request = NULL;
+    guint8 flags = 0;
+
+    if (!daemon_read(in, BIB_DAEMON_MAX_REQUEST, &flags, &request, &error)) {
+      g_printerr("Error reading request: %s\n", error->message);
+
+      // The payload is left unread, so the connection cannot be reused.
+      if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE)) {
+        daemon_write(out, BIB_DAEMON_ERROR, error->message, strlen(error->message), NULL);
+      }
+      break;
+    }
+
+    if (request == NULL) {
+      break;
+    }
+
+    g_autoptr(BIBEntryList) entries = bib_parse(request, 1, &error);
+    g_autoptr(GError) write_error = NULL;
+    gboolean ok = FALSE;
+
+    if (error != NULL) {
+      const gchar *message = error->message;
+      ok = daemon_write(out, BIB_DAEMON_ERROR, message, strlen(message), &write_error);
+    } else {
+      BIBOutputFormat format = flags & BIB_DAEMON_CSL ? BIB_OUTPUT_CSL : flags & BIB_DAEMON_NDJSON ? BIB_OUTPUT_NDJSON : BIB_OUTPUT_BIB;
+      BIBSink *sink = bib_sink_new();
+      bib_entry_list_print(sink, entries, format, flags & BIB_DAEMON_BIBTEX, 1);
+      g_autoptr(GBytes) formatted = bib_sink_free_to_bytes(sink);
+      gsize length = 0;
+      const gchar *text = g_bytes_get_data(formatted, &length);
+      ok = daemon_write(out, 0, text, length, &write_error);
+    }
+
+    if (!ok) {
+      g_printerr("Error writing response: %s\n", write_error->message);
+      break;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean daemon_quit(gpointer user_data) {
+  g_main_loop_quit(user_data);
+  return G_SOURCE_CONTINUE;
+}
+
+gboolean bib_daemon_serve(const struct options *options) {
+  g_autofree gchar *path = daemon_socket_path(options->socket);
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  g_autoptr(GSocketClient) client = g_socket_client_new();
+  g_autoptr(GSocketConnection) running = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address), NULL, NULL);
+  g_autoptr(GError) error = NULL;
+
+  if (running != NULL) {
+    g_printerr("A daemon is already listening on %s\n", path);
+    return FALSE;
+  }
+
+  // Nothing answered, so whatever is left at the path is stale.
+  g_unlink(path);
+
+  // One connection per core by default, as every request is converted on the
+  // thread that serves it.
+  gint max_threads = options->jobs > 1 ? options->jobs : (gint)g_get_num_processors();
+  g_autoptr(GSocketService) service = g_threaded_socket_service_new(max_threads);
+
+  // The socket is only accessible to the user from the start, rather than
+  // from a chmod once it already accepts connections.
+  mode_t mask = umask(0077);
+  gboolean listening = g_socket_listener_add_address(G_SOCKET_LISTENER(service), address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+  umask(mask);
+
+  if (!listening) {
+    g_printerr("Error listening on %s: %s\n", path, error->message);
+    return FALSE;
+  }
+
+  g_signal_connect(service, "run", G_CALLBACK(daemon_run), NULL);
+  g_socket_service_start(service);
+  g_printerr("Listening on %s\n", path);
+
+  // Interrupting the daemon is how it is stopped, so the socket file is
+  // removed then rather than left for the next one to find stale.
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  guint sigint = g_unix_signal_add(SIGINT, daemon_quit, loop);
+  guint sigterm = g_unix_signal_add(SIGTERM, daemon_quit, loop);
+  g_main_loop_run(loop);
+
+  g_source_remove(sigint);
+  g_source_remove(sigterm);
+  g_socket_service_stop(service);
+  g_socket_listener_close(G_SOCKET_LISTENER(service));
+  g_unlink(path);
+
+  return TRUE;
+}
+
+gboolean bib_daemon_request(const gchar *input, const struct options *options) {
+  g_autofree gchar *path = daemon_socket_path(options->socket);
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(path);
+  g_autoptr(GSocketClient) client = g_socket_client_new();
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GBytes) contents = NULL;
+
+  if (g_strcmp0(input, "-") == 0) {
+    GString *buffer = g_string_new(NULL);
+    gchar chunk[4096];
+    gsize length;
+    while ((length = fread(chunk, 1, sizeof(chunk), stdin)) > 0) {
+      g_string_append_len(buffer, chunk, length);
+    }
+    contents = g_string_free_to_bytes(buffer);
+  } else {
+    contents = bib_file_read(input, &error);
+  }
+
+  if (contents == NULL) {
+    g_printerr("Error reading file: %s\n", error->message);
+    return FALSE;
+  }
+
+  g_autoptr(GSocketConnection) connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address), NULL, &error);
+
+  if (connection == NULL) {
+    g_printerr("Error connecting to %s: %s\n", path, error->message);
+    return FALSE;
+  }
+
+  GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+  GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+  g_autoptr(GBytes) response = NULL;
+  guint8 flags = options->bibtex ? BIB_DAEMON_BIBTEX : 0;
+
+  if (options->output_format == BIB_OUTPUT_NDJSON) {
+    flags |= BIB_DAEMON_NDJSON;
+  } else if (options->output_format == BIB_OUTPUT_CSL) {
+    flags |= BIB_DAEMON_CSL;
+  }
+
+  gsize length = 0;
+  const gchar *data = g_bytes_get_data(contents, &length);
+
+  if (!daemon_write(out, flags, data, length, &error) || !daemon_read(in, G_MAXUINT64, &flags, &response, &error)) {
+    g_printerr("Error: %s\n", error->message);
+    return FALSE;
+  }
+
+  if (response == NULL) {
+    g_printerr("Error: the daemon closed the connection\n");
+    return FALSE;
+  }
+
+  data = g_bytes_get_data(response, &length);
+
+  if (flags & BIB_DAEMON_ERROR) {
+    g_printerr("Error: %.*s\n", (int)length, data);
+    return FALSE;
+  }
+
+  // Only .bib output ends with an extra newline, as when converting locally.
+  const gchar *end = options->output_format == BIB_OUTPUT_BIB ? "\n" : "";
+
+  if (options->output != NULL) {
+    g_autoptr(GString) text = g_string_new_len(data, length);
+    g_string_append(text, end);
+
+    if (!g_file_set_contents(options->output, text->str, text->len, &error)) {
+      g_printerr("Error writing file: %s\n", error->message);
+      return FALSE;
+    }
+  } else {
+    fwrite(data, 1, length, stdout);
+    fputs(end, stdout);
+  }
+
+  return TRUE;
+}
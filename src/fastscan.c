@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// A hand-written scanner for well-formed files, which finds the entries and
+// their fields without building a syntax tree. It only takes a strict subset
+// of the syntax,
+//
+//   @type{key, name = {value}, name = "value", name = word, ...}
+//
+// and declines every entry that is anything else: delimited by parentheses,
+// @string, @preamble and @comment, values joined with `#`, comments inside the
+// entry, backslashes before delimiters, non-ASCII types, keys or field names.
+// Those are left to tree-sitter. Text between entries is skipped as long as it
+// has no braces and no stray `@`; otherwise the scanner gives up on the file.
+//
+// Only `@`, `{`, `}`, `"` and `\` matter inside values, so the scanners below
+// find the next of them, and the rest of the text is skipped a block at a time.
+
+typedef gsize (*scan_func)(const gchar *text, gsize length);
+
+static bool is_delimiter(guchar c) {
+  return c == '@' || c == '{' || c == '}' || c == '"' || c == '\\';
+}
+
+static gsize scan_scalar(const gchar *text, gsize length) {
+  for (gsize i = 0; i < length; i++) {
+    if (is_delimiter(text[i])) {
+      return i;
+    }
+  }
+
+  return length;
+}
+
+#if defined(__SSE2__)
+static gsize scan_sse2(const gchar *text, gsize length) {
+  const __m128i at = _mm_set1_epi8('@');
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  gsize i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+    __m128i found = _mm_or_si128(_mm_cmpeq_epi8(block, at), _mm_cmpeq_epi8(block, open));
+    found = _mm_or_si128(found, _mm_or_si128(_mm_cmpeq_epi8(block, close), _mm_cmpeq_epi8(block, quote)));
+    found = _mm_or_si128(found, _mm_cmpeq_epi8(block, backslash));
+    guint mask = _mm_movemask_epi8(found);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + scan_scalar(text + i, length - i);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) static gsize scan_avx2(const gchar *text, gsize length) {
+  const __m256i at = _mm256_set1_epi8('@');
+  const __m256i open = _mm256_set1_epi8('{');
+  const __m256i close = _mm256_set1_epi8('}');
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  gsize i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(text + i));
+    __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(block, at), _mm256_cmpeq_epi8(block, open));
+    found = _mm256_or_si256(found, _mm256_or_si256(_mm256_cmpeq_epi8(block, close), _mm256_cmpeq_epi8(block, quote)));
+    found = _mm256_or_si256(found, _mm256_cmpeq_epi8(block, backslash));
+    guint mask = _mm256_movemask_epi8(found);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + scan_scalar(text + i, length - i);
+}
+#endif
+
+static scan_func scan_select(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_avx2;
+  }
+#endif
+#if defined(__SSE2__)
+  return scan_sse2;
+#else
+  return scan_scalar;
+#endif
+}
+
+// Returns the offset of the first delimiter in text[i, length), or `length`.
+static gsize next_delimiter(const gchar *text, gsize length, gsize i) {
+  static gsize func = 0;
+
+  if (g_once_init_enter(&func)) {
+    g_once_init_leave(&func, (gsize)scan_select());
+  }
+
+  return i + ((scan_func)func)(text + i, length - i);
+}
+
+static gsize skip_space(const gchar *text, gsize length, gsize i) {
+  while (i < length && g_ascii_isspace(text[i])) {
+    i++;
+  }
+  return i;
+}
+
+// Types and field names, as scan.c takes them.
+static gsize skip_name(const gchar *text, gsize length, gsize i) {
+  while (i < length && (g_ascii_isalnum(text[i]) || text[i] == '_' || text[i] == '-')) {
+    i++;
+  }
+  return i;
+}
+
+static gsize skip_key(const gchar *text, gsize length, gsize i) {
+  while (i < length && (g_ascii_isalnum(text[i]) || (text[i] != '\0' && strchr("_-:./+", text[i]) != NULL))) {
+    i++;
+  }
+  return i;
+}
+
+static gsize skip_word(const gchar *text, gsize length, gsize i) {
+  while (i < length && (g_ascii_isalnum(text[i]) || text[i] == '_')) {
+    i++;
+  }
+  return i;
+}
+
+static gboolean is_special_type(const gchar *type, gsize length) {
+  return (length == strlen("comment") && g_ascii_strncasecmp(type, "comment", length) == 0) ||
+         (length == strlen("string") && g_ascii_strncasecmp(type, "string", length) == 0) ||
+         (length == strlen("preamble") && g_ascii_strncasecmp(type, "preamble", length) == 0);
+}
+
+// Returns the offset just past the brace closing the entry opened at `open`,
+// or 0 if the input ends first.
+static gsize entry_end(const gchar *text, gsize length, gsize open) {
+  gsize depth = 0;
+
+  for (gsize i = next_delimiter(text, length, open + 1); i < length; i = next_delimiter(text, length, i + 1)) {
+    if (text[i] == '{') {
+      depth++;
+    } else if (text[i] == '}' && depth == 0) {
+      return i + 1;
+    } else if (text[i] == '}') {
+      depth--;
+    }
+  }
+
+  return 0;
+}
+
+// Returns the offset just past the value starting at `i`, or 0 if it is not
+// one the scanner is sure about.
+static gsize skip_value(const gchar *text, gsize length, gsize i) {
+  if (i >= length) {
+    return 0;
+  }
+
+  if (text[i] != '{' && text[i] != '"') {
+    gsize end = skip_word(text, length, i);
+    return end > i ? end : 0;
+  }
+
+  gboolean quoted = text[i] == '"';
+  gsize depth = 0;
+
+  for (gsize j = next_delimiter(text, length, i + 1); j < length; j = next_delimiter(text, length, j + 1)) {
+    switch (text[j]) {
+      case '{':
+        depth++;
+        break;
+      case '}':
+        if (depth == 0) {
+          return quoted ? 0 : j + 1;
+        }
+        depth--;
+        break;
+      case '"':
+        if (quoted && depth == 0) {
+          return j + 1;
+        }
+        break;
+      case '\\':
+        // Whether these escape the delimiter is up to the grammar.
+        if (j + 1 < length && (text[j + 1] == '{' || text[j + 1] == '}' || (quoted && depth == 0 && text[j + 1] == '"'))) {
+          return 0;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return 0;
+}
+
+// Finds the entries of the file, or returns NULL if the text between them is
+// more than the scanner is sure about. Each span starts at `@type{` and ends
+// past the brace that closes it.
+GArray *bib_fast_split(const gchar *text, gsize length) {
+  g_autoptr(GArray) spans = g_array_new(FALSE, FALSE, sizeof(BIBSpan));
+  gsize i = next_delimiter(text, length, 0);
+
+  while (i < length) {
+    if (text[i] == '"' || text[i] == '\\') {
+      i = next_delimiter(text, length, i + 1);
+      continue;
+    }
+
+    if (text[i] != '@') {
+      return NULL;
+    }
+
+    gsize open = skip_name(text, length, i + 1);
+
+    if (open == i + 1 || open >= length || text[open] != '{') {
+      return NULL;
+    }
+
+    BIBSpan span = {.start = i, .end = entry_end(text, length, open)};
+
+    if (span.end == 0) {
+      return NULL;
+    }
+
+    g_array_append_val(spans, span);
+    i = next_delimiter(text, length, span.end);
+  }
+
+  return g_steal_pointer(&spans);
+}
+
+// Converts the entry of a span from bib_fast_split, or returns NULL if it is
+// not one the scanner is sure about. Declined entries may leave some memory
+// behind in `arena`.
+BIBEntry *bib_fast_parse_entry(const gchar *text, const BIBSpan *span, BIBArena *arena) {
+  gsize close = span->end - 1;
+  gsize type_start = span->start + 1;
+  gsize type_end = skip_name(text, close, type_start);
+
+  if (is_special_type(text + type_start, type_end - type_start)) {
+    return NULL;
+  }
+
+  gsize key_start = skip_space(text, close, type_end + 1);
+  gsize key_end = skip_key(text, close, key_start);
+  gsize i = skip_space(text, close, key_end);
+
+  if (key_end == key_start || (i < close && text[i] != ',')) {
+    return NULL;
+  }
+
+  // Types, keys and names are plain ASCII, which bib_normalize would return
+  // as they are.
+  BIBEntry *entry = bib_entry_create(arena);
+  guint64 year = 0;
+  guint64 month = 0;
+
+  bib_parse_type(entry, bib_string_view(text + type_start, type_end - type_start));
+  bib_parse_key(entry, bib_string_view(text + key_start, key_end - key_start));
+
+  // `i` is at the comma before each field, or at the closing brace.
+  while (i < close) {
+    gsize name_start = skip_space(text, close, i + 1);
+
+    if (name_start == close) {
+      break;
+    }
+
+    gsize name_end = skip_name(text, close, name_start);
+    gsize equals = skip_space(text, close, name_end);
+
+    if (name_end == name_start || equals == close || text[equals] != '=') {
+      return NULL;
+    }
+
+    gsize value_start = skip_space(text, close, equals + 1);
+    gsize value_end = skip_value(text, close, value_start);
+
+    if (value_end == 0) {
+      return NULL;
+    }
+
+    BIBString name = bib_string_view(text + name_start, name_end - name_start);
+    bib_parse_field(entry, name, text + value_start, value_end - value_start, &year, &month);
+
+    i = skip_space(text, close, value_end);
+
+    if (i < close && text[i] != ',') {
+      return NULL;
+    }
+  }
+
+  bib_parse_date(entry, year, month);
+
+  return entry;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+// Field names are stored as small integer IDs. Known names map to fixed IDs
+// through the generated, read-only table in mappings.c, so looking them up
+// takes no lock. Other names are interned on first sight and, like GQuarks,
+// live as long as the process.
+//
+// Interning takes a lock, but bib_field_name, which the printing threads call
+// for every unknown field, must not. Interned names go into pages that never
+// move once allocated, page k holding BIB_FIELD_PAGE_SIZE << k names, and
+// `interned_count` is only raised once a name is in place.
+
+#define BIB_FIELD_PAGE_BITS 8
+#define BIB_FIELD_PAGE_SIZE (1u << BIB_FIELD_PAGE_BITS)
+#define BIB_FIELD_PAGES (32 - BIB_FIELD_PAGE_BITS)
+
+static GHashTable *interned_ids = NULL;
+static BIBString *interned_pages[BIB_FIELD_PAGES];
+static gint interned_count = 0;
+static GMutex interned_lock;
+
+static BIBString *interned_slot(guint index, gboolean allocate) {
+  guint n = index + BIB_FIELD_PAGE_SIZE;
+  guint page = g_bit_storage(n) - 1 - BIB_FIELD_PAGE_BITS;
+  BIBString *names = g_atomic_pointer_get(&interned_pages[page]);
+
+  if (names == NULL && allocate) {
+    names = g_new(BIBString, BIB_FIELD_PAGE_SIZE << page);
+    g_atomic_pointer_set(&interned_pages[page], names);
+  }
+
+  return &names[n - (BIB_FIELD_PAGE_SIZE << page)];
+}
+
+// `name` is expected to be lowercase already, as the parser leaves it.
+guint bib_field_intern(const BIBString *name) {
+  gint known = bib_field_lookup(name);
+  gpointer id = NULL;
+
+  if (known >= 0) {
+    return known;
+  }
+
+  g_mutex_lock(&interned_lock);
+
+  if (interned_ids == NULL) {
+    interned_ids = g_hash_table_new((GHashFunc)bib_string_hash, (GEqualFunc)bib_string_equal);
+  }
+
+  if (!g_hash_table_lookup_extended(interned_ids, name, NULL, &id)) {
+    guint index = interned_count;
+    BIBString *slot = interned_slot(index, TRUE);
+    *slot = bib_string_take(bib_string_dup(name));
+    id = GUINT_TO_POINTER(BIB_FIELD_KNOWN + index);
+    g_hash_table_insert(interned_ids, slot, id);
+    g_atomic_int_set(&interned_count, index + 1);
+  }
+
+  g_mutex_unlock(&interned_lock);
+
+  return GPOINTER_TO_UINT(id);
+}
+
+const BIBString *bib_field_name(guint id) {
+  if (id < BIB_FIELD_KNOWN) {
+    return &bib_fields[id].name;
+  }
+
+  guint index = id - BIB_FIELD_KNOWN;
+  g_return_val_if_fail(index < (guint)g_atomic_int_get(&interned_count), NULL);
+
+  return interned_slot(index, FALSE);
+}
+
+guint bib_field_to_biblatex(guint id) {
+  return id < BIB_FIELD_KNOWN ? bib_fields[id].biblatex : id;
+}
+
+guint bib_field_to_bibtex(guint id) {
+  return id < BIB_FIELD_KNOWN ? bib_fields[id].bibtex : id;
+}
+
+guint bib_field_flags(guint id) {
+  return id < BIB_FIELD_KNOWN ? bib_fields[id].flags : 0;
+}
+
+// Orders fields as they are printed: known fields by their rank in the
+// generated table, then unknown ones by name.
+gint bib_field_compare(guint a, guint b) {
+  guint order_a = a < BIB_FIELD_KNOWN ? bib_fields[a].order : G_MAXUINT;
+  guint order_b = b < BIB_FIELD_KNOWN ? bib_fields[b].order : G_MAXUINT;
+
+  if (order_a != order_b) {
+    return order_a < order_b ? -1 : 1;
+  }
+
+  if (a == b || order_a != G_MAXUINT) {
+    return 0;
+  }
+
+  const BIBString *name_a = bib_field_name(a);
+  const BIBString *name_b = bib_field_name(b);
+  gint cmp = memcmp(name_a->str, name_b->str, MIN(name_a->len, name_b->len));
+
+  return cmp != 0 ? cmp : (name_a->len > name_b->len) - (name_a->len < name_b->len);
+}
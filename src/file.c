@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+// gzip and zstd input is decompressed on the fly.
+GInputStream *bib_file_open(const gchar *path, GError **error) {
+  g_autoptr(GFile) file = g_file_new_for_commandline_arg(path);
+  g_autoptr(GInputStream) in = G_INPUT_STREAM(g_file_read(file, NULL, error));
+  return in != NULL ? bib_decompress_input(in, error) : NULL;
+}
+
+// Local regular files are mapped straight into memory, unless they turn out to
+// be compressed. Anything else (URIs, pipes, special files) is read through
+// GIO.
+static GBytes *file_read_all(const gchar *path, GError **error) {
+  g_autoptr(GError) fn_error = NULL;
+  g_autoptr(GFile) file = g_file_new_for_commandline_arg(path);
+  g_autofree gchar *local_path = g_file_get_path(file);
+
+  if (local_path != NULL && g_file_test(local_path, G_FILE_TEST_IS_REGULAR)) {
+    g_autoptr(GMappedFile) mapped = g_mapped_file_new(local_path, FALSE, error);
+
+    if (mapped == NULL) {
+      return NULL;
+    }
+
+    const guint8 *data = (const guint8 *)g_mapped_file_get_contents(mapped);
+
+    if (bib_compression_detect(data, g_mapped_file_get_length(mapped)) == BIB_COMPRESSION_NONE) {
+      return g_mapped_file_get_bytes(mapped);
+    }
+  }
+
+  g_autoptr(GInputStream) in = bib_file_open(path, &fn_error);
+
+  if (fn_error != NULL) {
+    g_propagate_error(error, g_steal_pointer(&fn_error));
+    return NULL;
+  }
+
+  // Read straight into the string, as decompressed archives can be large.
+  GString *contents = g_string_new(NULL);
+  gssize length;
+
+  do {
+    gsize old_length = contents->len;
+    g_string_set_size(contents, old_length + 64 * 1024);
+    length = g_input_stream_read(in, contents->str + old_length, 64 * 1024, NULL, &fn_error);
+    g_string_set_size(contents, old_length + MAX(length, 0));
+  } while (length > 0);
+
+  if (fn_error != NULL) {
+    g_propagate_error(error, g_steal_pointer(&fn_error));
+    g_string_free(contents, TRUE);
+    return NULL;
+  }
+
+  return g_string_free_to_bytes(contents);
+}
+
+// Mapped files are only read as they are used, so their read time mostly ends
+// up in the phases that follow.
+GBytes *bib_file_read(const gchar *path, GError **error) {
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+  GBytes *contents = file_read_all(path, error);
+  bib_stats_stop(&timer, BIB_PHASE_READ);
+
+  if (contents != NULL) {
+    bib_stats_add(bytes_in, g_bytes_get_size(contents));
+  }
+
+  return contents;
+}
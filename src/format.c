@@ -17,155 +17,333 @@
 #include "internal.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#define BIB_PRINT_BATCH_SIZE 1024
 
 static GRegex *date_regex = NULL;
 
-GString *bib_property_print(gchar *key, gchar *val, gsize length, gboolean bibtex) {
-  GString *property = g_string_new("");
+// Finds the year and month BibTeX wants in a biblatex date. Ranges keep their
+// start.
+gboolean bib_date_split(const BIBString *date, guint64 *year, guint64 *month) {
+  if (g_once_init_enter(&date_regex)) {
+    g_once_init_leave(&date_regex, g_regex_new("{?([0-9-]+)\\/?", G_REGEX_OPTIMIZE, G_REGEX_MATCH_DEFAULT, NULL));
+  }
 
-  if (bibtex && g_ascii_strcasecmp(key, "date") == 0) {
-    if (date_regex == NULL) {
-      date_regex = g_regex_new("{?([0-9-]+)\\/?", G_REGEX_OPTIMIZE, G_REGEX_MATCH_DEFAULT, NULL);
-    }
+  g_autoptr(GMatchInfo) match_info = NULL;
+  if (!g_regex_match_full(date_regex, date->str, date->len, 0, G_REGEX_MATCH_DEFAULT, &match_info, NULL)) {
+    return FALSE;
+  }
 
-    g_autoptr(GMatchInfo) match_info = NULL;
-    if (g_regex_match(date_regex, val, G_REGEX_MATCH_DEFAULT, &match_info)) {
-      g_autofree gchar *match = g_match_info_fetch(match_info, 1);
-      guint64 year = 0;
-      guint64 month = 0;
-      sscanf(match, "%lu-%lu", &year, &month);
+  g_autofree gchar *match = g_match_info_fetch(match_info, 1);
+  sscanf(match, "%lu-%lu", year, month);
+  return TRUE;
+}
 
+void bib_property_print(BIBSink *sink, guint id, const BIBString *val, gsize length, gboolean bibtex) {
+  const BIBString *key = bib_field_name(id);
+
+  if (bibtex && id == BIB_FIELD_DATE) {
+    guint64 year = 0;
+    guint64 month = 0;
+
+    if (bib_date_split(val, &year, &month)) {
       if (year > 0) {
-        g_autofree gchar *fill = g_strnfill(length - strlen("year") + 1, ' ');
-        g_string_printf(property, "    year%s= %lu,\n", fill, year);
+        bib_sink_append(sink, "    year", strlen("    year"));
+        bib_sink_fill(sink, ' ', length - strlen("year") + 1);
+        bib_sink_printf(sink, "= %lu,\n", year);
       }
 
       if (month > 0) {
-        g_autofree gchar *fill = g_strnfill(length - strlen("month") + 1, ' ');
-        g_string_append_printf(property, "    month%s= %lu,\n", fill, month);
+        bib_sink_append(sink, "    month", strlen("    month"));
+        bib_sink_fill(sink, ' ', length - strlen("month") + 1);
+        bib_sink_printf(sink, "= %lu,\n", month);
       }
     } else {
-      g_printerr("Could not parse date [%s]\n", val);
-      return NULL;
+      g_printerr("Could not parse date [%.*s]\n", bib_string_args(val));
     }
   } else {
-    g_autofree gchar *fill = g_strnfill(length - strlen(key) + 1, ' ');
-    g_string_printf(property, "    %s%s= %s,\n", key, fill, val);
+    bib_sink_append(sink, "    ", 4);
+    bib_sink_append(sink, key->str, key->len);
+    bib_sink_fill(sink, ' ', length - key->len + 1);
+    bib_sink_append(sink, "= ", 2);
+    bib_sink_append(sink, val->str, val->len);
+    bib_sink_append(sink, ",\n", 2);
   }
-
-  return property;
 }
 
-gchar *bib_entry_print_type(BIBEntry *entry) {
-  if (g_strcmp0(entry->type, "report") == 0) {
-    return g_strdup("techreport");
-  } else if (g_strcmp0(entry->type, "online") == 0) {
-    return g_strdup("misc");
-  } else if (g_strcmp0(entry->type, "thesis") == 0) {
-    gchar *type = g_hash_table_lookup(entry->properties, "type");
-    if (type != NULL && type[0] == 'm') {
-      return g_strdup("mastersthesis");
-    } else {
-      return g_strdup("phdthesis");
+BIBString bib_entry_print_type(BIBEntry *entry) {
+  const BIBTypeInfo *info = bib_type_lookup(&entry->type);
+
+  if (info == NULL || info->bibtex.len == 0) {
+    return entry->type;
+  }
+
+  // BibTeX has no generic thesis, the type field tells which one it is.
+  if (bib_string_caseeq(&entry->type, "thesis")) {
+    const BIBString *field = bib_entry_get(entry, BIB_FIELD_TYPE);
+    g_auto(BIBString) type = field != NULL ? bib_string_resolve(field) : bib_string_literal("");
+    if (type.len > 0 && type.str[0] == 'm') {
+      return bib_string_literal("mastersthesis");
     }
   }
 
-  return g_strdup(entry->type);
+  return info->bibtex;
+}
+
+static guint print_id(const BIBField *field, gboolean bibtex) {
+  return bibtex ? bib_field_to_bibtex(field->id) : field->id;
 }
 
-gchar *bib_entry_print_property(gchar *property) {
-  if (g_strcmp0(property, "location") == 0) {
-    return g_strdup("address");
-  } else if (g_strcmp0(property, "journaltitle") == 0) {
-    return g_strdup("journal");
+// The length of the name a field is printed under. BibTeX names can be longer
+// than the biblatex ones, and a date becomes a year and a month.
+static gsize print_name_length(guint id, gboolean bibtex) {
+  if (bibtex && id == BIB_FIELD_DATE) {
+    return MAX(strlen("year"), strlen("month"));
   }
 
-  return g_strdup(property);
+  return bib_field_name(id)->len;
 }
 
-GString *bib_entry_print(BIBEntry *entry, gboolean bibtex) {
-  GString *formatted = g_string_sized_new(sizeof(char) * 80 * 7); // ~ 7 lines of 80 char per entry
-  if (bibtex) {
-    g_autofree gchar *type = bib_entry_print_type(entry);
-    g_string_printf(formatted, "@%s{%s,\n", type, entry->key);
-  } else {
-    g_string_printf(formatted, "@%s{%s,\n", entry->type, entry->key);
-  }
+struct print_order {
+  BIBEntry *entry;
+  gboolean bibtex;
+};
 
-  gsize max_length = 0;
-  GList *keys = g_hash_table_get_keys(entry->properties);
-  GList *printable_keys = NULL;
+static gint print_order_compare(gconstpointer a, gconstpointer b, gpointer user_data) {
+  const struct print_order *context = user_data;
+  const BIBField *field_a = &context->entry->fields[*(const guint *)a];
+  const BIBField *field_b = &context->entry->fields[*(const guint *)b];
+  return bib_field_compare(print_id(field_a, context->bibtex), print_id(field_b, context->bibtex));
+}
+
+// Fills `order` with the indices of the fields that get printed, in the order
+// they are printed in, and returns how many there are. `order` must have room
+// for all fields of the entry. `max_length` is the longest name among them,
+// which the .bib output aligns the values to.
+guint bib_entry_print_fields(BIBEntry *entry, gboolean bibtex, guint *order, gsize *max_length) {
   gboolean has_doi = false;
+  guint n_order = 0;
+
+  *max_length = 0;
+
+  // Fields are printed in a fixed order, whatever order the source had them
+  // in. There are rarely more than a couple dozen, so they are insertion
+  // sorted through an index, keyed on the name they are printed under. Past
+  // BIB_PRINT_STACK_FIELDS that would be quadratic, and they are merge sorted
+  // once collected instead.
+  gboolean many = entry->n_fields > BIB_PRINT_STACK_FIELDS;
 
-  for (GList *k = keys; k != NULL; k = k->next) {
-    gchar *key = k->data;
+  for (guint i = 0; i < entry->n_fields; i++) {
+    const BIBField *field = &entry->fields[i];
 
-    if ((g_ascii_strcasecmp(key, "keywords") == 0) ||
-        (g_ascii_strcasecmp(key, "abstract") == 0) ||
-        (g_ascii_strcasecmp(key, "file") == 0)) {
+    if (bib_field_flags(field->id) & BIB_FIELD_SKIP) {
       continue;
     }
 
-    if (g_ascii_strcasecmp(key, "doi") == 0) {
+    if (field->id == BIB_FIELD_DOI) {
       has_doi = true;
     }
 
-    max_length = MAX(strlen(key), max_length);
-    printable_keys = g_list_append(printable_keys, key);
-  }
-
-  for (GList *k = printable_keys; k != NULL; k = k->next) {
-    gchar *key = k->data;
-    gchar *val = g_hash_table_lookup(entry->properties, key);
+    guint id = print_id(field, bibtex);
+    *max_length = MAX(print_name_length(id, bibtex), *max_length);
 
-    if (has_doi && (0 == g_ascii_strcasecmp(key, "issn") ||
-                    0 == g_ascii_strcasecmp(key, "isbn") ||
-                    0 == g_ascii_strcasecmp(key, "eprint") ||
-                    0 == g_ascii_strcasecmp(key, "eprintype") ||
-                    0 == g_ascii_strcasecmp(key, "eprintclass") ||
-                    0 == g_ascii_strcasecmp(key, "url") ||
-                    0 == g_ascii_strcasecmp(key, "urldate"))) {
+    if (many) {
+      order[n_order++] = i;
       continue;
     }
 
-    if (bibtex) {
-      g_autofree gchar *bibtex_key = bib_entry_print_property(key);
-      g_autoptr(GString) property = bib_property_print(bibtex_key, val, max_length, bibtex);
+    guint j = n_order++;
+    while (j > 0 && bib_field_compare(id, print_id(&entry->fields[order[j - 1]], bibtex)) < 0) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
 
-      if (property == NULL) {
-        continue;
-      }
+  if (many) {
+    struct print_order context = {.entry = entry, .bibtex = bibtex};
+    g_autoptr(GArray) sorted = g_array_sized_new(FALSE, FALSE, sizeof(guint), n_order);
+    g_array_append_vals(sorted, order, n_order);
+    // Stable, so equal names keep the order of the source.
+    g_array_sort_with_data(sorted, print_order_compare, &context);
+    memcpy(order, sorted->data, sizeof(guint) * n_order);
+  }
 
-      g_string_append_len(formatted, property->str, property->len);
-    } else {
-      g_autoptr(GString) property = bib_property_print(key, val, max_length, bibtex);
-      g_string_append_len(formatted, property->str, property->len);
+  if (!has_doi) {
+    return n_order;
+  }
+
+  guint n_kept = 0;
+
+  for (guint i = 0; i < n_order; i++) {
+    if (!(bib_field_flags(entry->fields[order[i]].id) & BIB_FIELD_SKIP_WITH_DOI)) {
+      order[n_kept++] = order[i];
     }
   }
 
-  g_list_free(keys);
-  g_list_free(printable_keys);
+  return n_kept;
+}
+
+void bib_entry_print(BIBSink *sink, BIBEntry *entry, gboolean bibtex) {
+  BIBString type = bibtex ? bib_entry_print_type(entry) : entry->type;
 
-  g_string_append(formatted, "}");
+  bib_sink_append(sink, "@", 1);
+  bib_sink_append(sink, type.str, type.len);
+  bib_sink_append(sink, "{", 1);
+  bib_sink_append(sink, entry->key.str, entry->key.len);
+  bib_sink_append(sink, ",\n", 2);
+
+  guint stack_order[BIB_PRINT_STACK_FIELDS];
+  g_autofree guint *heap_order = entry->n_fields > BIB_PRINT_STACK_FIELDS ? g_new(guint, entry->n_fields) : NULL;
+  guint *order = heap_order != NULL ? heap_order : stack_order;
+  gsize max_length = 0;
+  guint n_order = bib_entry_print_fields(entry, bibtex, order, &max_length);
 
-  return formatted;
+  for (guint i = 0; i < n_order; i++) {
+    const BIBField *field = &entry->fields[order[i]];
+    g_auto(BIBString) value = bib_string_resolve(&field->value);
+    bib_property_print(sink, print_id(field, bibtex), &value, max_length, bibtex);
+  }
+
+  bib_sink_append(sink, "}", 1);
 }
 
-GString *bib_entry_list_print(BIBEntryList *list, gboolean bibtex) {
-  GString *formatted = g_string_sized_new(sizeof(char) * list->len * 80 * 7); // ~ 7 lines of 80 char per entry
+static const BIBOutputFrame output_frames[] = {
+    [BIB_OUTPUT_BIB] = {"", "", "\n\n", ""},
+    [BIB_OUTPUT_NDJSON] = {"", "", "\n", ""},
+    [BIB_OUTPUT_CSL] = {"[\n", ",\n", "", "\n]\n"},
+};
+
+gboolean bib_output_format_parse(const gchar *name, BIBOutputFormat *format) {
+  if (name == NULL || g_strcmp0(name, "bib") == 0) {
+    *format = BIB_OUTPUT_BIB;
+  } else if (g_strcmp0(name, "ndjson") == 0) {
+    *format = BIB_OUTPUT_NDJSON;
+  } else if (g_strcmp0(name, "csl-json") == 0 || g_strcmp0(name, "csl") == 0) {
+    *format = BIB_OUTPUT_CSL;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+const BIBOutputFrame *bib_output_frame(BIBOutputFormat format) {
+  return &output_frames[format];
+}
+
+static void print_entry(BIBSink *sink, BIBEntry *entry, BIBOutputFormat format, gboolean bibtex) {
+  switch (format) {
+  case BIB_OUTPUT_NDJSON:
+    bib_entry_print_json(sink, entry, bibtex);
+    break;
+  case BIB_OUTPUT_CSL:
+    bib_entry_print_csl(sink, entry);
+    break;
+  default:
+    bib_entry_print(sink, entry, bibtex);
+    break;
+  }
+
+  const gchar *terminator = output_frames[format].terminator;
+  bib_sink_append(sink, terminator, strlen(terminator));
+}
+
+// Formats one entry into a standalone string, for callers that keep entries'
+// output around individually. The text ends with the terminator of the format,
+// the separators are left to the caller.
+GBytes *bib_entry_format(BIBEntry *entry, BIBOutputFormat format, gboolean bibtex) {
+  BIBSink *sink = bib_sink_new();
+  print_entry(sink, entry, format, bibtex);
+  return bib_sink_free_to_bytes(sink);
+}
+
+struct print_batch {
+  BIBEntryList *list;
+  const gboolean *skip;
+  gsize first;
+  gsize count;
+  // The first entry printed at all, which gets no separator before it.
+  gsize leader;
+  BIBOutputFormat format;
+  gboolean bibtex;
+  BIBSink *sink;
+};
+
+static void bib_entry_list_print_batch(gpointer data, gpointer user_data) {
+  struct print_batch *batch = data;
 
-  gchar *last_key = NULL;
-  for (gsize i = 0; i < list->len; i++) {
-    BIBEntry *entry = g_ptr_array_index(list, i);
-    if (g_strcmp0(last_key, entry->key) == 0) {
-      g_printerr("Skipping duplicate key %s\n", last_key);
+  for (gsize i = batch->first; i < batch->first + batch->count; i++) {
+    if (batch->skip[i]) {
       continue;
     }
-    g_autoptr(GString) formatted_entry = bib_entry_print(entry, bibtex);
-    g_string_append(formatted, formatted_entry->str);
-    g_string_append(formatted, "\n\n");
-    last_key = entry->key;
+    if (i != batch->leader) {
+      const gchar *separator = output_frames[batch->format].separator;
+      bib_sink_append(batch->sink, separator, strlen(separator));
+    }
+    print_entry(batch->sink, g_ptr_array_index(batch->list->entries, i), batch->format, batch->bibtex);
+  }
+}
+
+void bib_entry_list_print(BIBSink *sink, BIBEntryList *list, BIBOutputFormat format, gboolean bibtex, guint jobs) {
+  GPtrArray *entries = list->entries;
+  g_autofree gboolean *skip = g_new0(gboolean, entries->len);
+  const BIBOutputFrame *frame = &output_frames[format];
+  gsize leader = entries->len;
+
+  // Keys are sorted ignoring case but compared exactly, so duplicates need
+  // not be next to each other. The sort is stable, so the first one wins.
+  g_autoptr(GHashTable) seen = g_hash_table_new((GHashFunc)bib_string_hash, (GEqualFunc)bib_string_equal);
+  for (gsize i = 0; i < entries->len; i++) {
+    BIBEntry *entry = g_ptr_array_index(entries, i);
+    if (!g_hash_table_add(seen, &entry->key)) {
+      g_printerr("Skipping duplicate key %.*s\n", bib_string_args(&entry->key));
+      bib_stats_add(duplicates, 1);
+      skip[i] = TRUE;
+    } else if (leader == entries->len) {
+      leader = i;
+    }
+  }
+
+  bib_sink_append(sink, frame->open, strlen(frame->open));
+
+  if (jobs <= 1) {
+    struct print_batch batch = {.list = list, .skip = skip, .count = entries->len, .leader = leader, .format = format, .bibtex = bibtex, .sink = sink};
+    bib_entry_list_print_batch(&batch, NULL);
+    bib_sink_append(sink, frame->close, strlen(frame->close));
+    return;
+  }
+
+  // Each worker formats a batch into its own sink. Batches are contiguous, so
+  // splicing them in order gives the same output as a single thread would,
+  // and going a window at a time keeps only a bounded part of the output in
+  // memory before it is written.
+  gsize batch_size = CLAMP(entries->len / (jobs * 4), 1, BIB_PRINT_BATCH_SIZE);
+  gsize n_batches = jobs * 4;
+  g_autofree struct print_batch *batches = g_new0(struct print_batch, n_batches);
+
+  for (gsize first = 0; first < entries->len; first += batch_size * n_batches) {
+    gsize count = 0;
+
+    for (; count < n_batches && first + count * batch_size < entries->len; count++) {
+      batches[count].list = list;
+      batches[count].skip = skip;
+      batches[count].first = first + count * batch_size;
+      batches[count].count = MIN(batch_size, entries->len - batches[count].first);
+      batches[count].leader = leader;
+      batches[count].format = format;
+      batches[count].bibtex = bibtex;
+      batches[count].sink = bib_sink_new();
+    }
+
+    bib_parallel_for(batches, count, sizeof(*batches), bib_entry_list_print_batch, NULL, jobs);
+
+    for (gsize i = 0; i < count; i++) {
+      bib_sink_splice(sink, batches[i].sink);
+      g_clear_pointer(&batches[i].sink, bib_sink_free);
+    }
   }
 
-  return formatted;
+  bib_sink_append(sink, frame->close, strlen(frame->close));
 }
@@ -17,9 +17,13 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include <gio/gio.h>
 #include <glib.h>
+#include <tree_sitter/api.h>
+
+#include "mappings.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 ///                                                                          ///
@@ -27,20 +31,222 @@
 ///                                                                          ///
 ////////////////////////////////////////////////////////////////////////////////
 
+// What --on-conflict does when --merge finds the same entry twice.
+typedef enum {
+  BIB_MERGE_FIRST,
+  BIB_MERGE_LAST,
+  BIB_MERGE_FIELDS,
+  BIB_MERGE_ERROR,
+} BIBMergePolicy;
+
+// What makes two entries the same for --merge. Keys always do.
+enum BIBMergeMatch {
+  BIB_MATCH_KEY = 1 << 0,
+  BIB_MATCH_DOI = 1 << 1,
+  BIB_MATCH_TITLE = 1 << 2,
+};
+
+// Compression of the input, found from its magic bytes, or of the output, as
+// given with --compress.
+typedef enum {
+  BIB_COMPRESSION_NONE,
+  BIB_COMPRESSION_GZIP,
+  BIB_COMPRESSION_ZSTD,
+} BIBCompression;
+
+// What the entries are printed as, chosen with --format. -b picks the field
+// names of the .bib and NDJSON outputs; CSL-JSON has its own.
+typedef enum {
+  BIB_OUTPUT_BIB,
+  BIB_OUTPUT_NDJSON,
+  BIB_OUTPUT_CSL,
+} BIBOutputFormat;
+
 struct options {
   gboolean bibtex;
   gboolean version;
+  gint jobs;
+  gboolean stream;
+  gint chunk_size;
+  gboolean batch;
+  gchar *files_from;
+  gchar *output_dir;
+  gchar **cite;
+  gchar **cite_files;
+  gboolean no_cache;
+  gboolean no_fast_scan;
+  gchar *cache_dir;
+  gboolean watch;
+  gchar *output;
+  gboolean daemon;
+  gboolean client;
+  gchar *socket;
+  gboolean stats;
+  gboolean stats_json;
+  gboolean merge;
+  gchar **match;
+  gchar *on_conflict;
+  guint merge_match;
+  BIBMergePolicy merge_policy;
+  gchar *compress;
+  BIBCompression compression;
+  gchar *format;
+  BIBOutputFormat output_format;
   gchar **rest;
 };
 
+// A slice of text. It either points straight into the source bytes handed to
+// bib_parse, which must then outlive it, or into `owned` when normalization had
+// to rewrite the bytes. Not NUL-terminated, print it with bib_string_args.
+// A `pending` slice is raw source text that is only normalized when read
+// through bib_string_resolve, so fields that are never printed cost nothing.
+struct BIBString {
+  const gchar *str;
+  gsize len;
+  gchar *owned;
+  gboolean pending;
+};
+
+// `id` is a BIBFieldId, or an ID from bib_field_intern for unknown names.
+struct BIBField {
+  guint id;
+  struct BIBString value;
+};
+
+// A row of the generated field mapping table (see tools/gen-mappings.py).
+struct BIBFieldInfo {
+  struct BIBString name;
+  guint biblatex;
+  guint bibtex;
+  guint flags;
+  guint order;
+};
+
+// A row of the generated type mapping table. Empty strings mean the type is
+// kept as it is.
+struct BIBTypeInfo {
+  struct BIBString name;
+  struct BIBString biblatex;
+  struct BIBString subtype;
+  struct BIBString bibtex;
+};
+
+// Entries, their fields and any text they own live in the arena they were
+// created from, and are released with it. Entries with many fields also get an
+// `index` from field ID to position, see bib_entry_set.
 struct BIBEntry {
-  gchar *type;
-  gchar *key;
-  GHashTable *properties;
+  struct BIBString type;
+  struct BIBString key;
+  struct BIBField *fields;
+  guint n_fields;
+  guint capacity;
+  guint *index;
+  guint index_size;
+  guint indexed;
+  struct BIBArena *arena;
+};
+
+// The arenas hold the memory of the entries, so they are freed with the list.
+struct BIBEntryList {
+  GPtrArray *entries;
+  GPtrArray *arenas;
+};
+
+// Tracks top-level `@` entry starts while input arrives in pieces. `boundary`
+// is the offset of the last one seen outside of any entry. `header` is set
+// between an `@` and the delimiter opening its entry. Inside the entry,
+// `close` is the delimiter that ends it, `depth` counts the braces open and
+// `quoted` tells whether a "..." value directly in the entry is open.
+struct BIBSplitter {
+  gsize depth;
+  gchar close;
+  gboolean header;
+  gboolean quoted;
+  gsize scanned;
+  gsize boundary;
+};
+
+// Where an entry sits in the source, as found by bib_scan_entries.
+struct BIBSpan {
+  gsize start;
+  gsize end;
+  struct BIBString key;
+};
+
+typedef enum {
+  BIB_STATS_OFF,
+  BIB_STATS_TEXT,
+  BIB_STATS_JSON,
+} BIBStatsFormat;
+
+typedef enum {
+  BIB_PHASE_READ,
+  BIB_PHASE_CACHE,
+  BIB_PHASE_PARSE,
+  BIB_PHASE_CONVERT,
+  BIB_PHASE_SORT,
+  BIB_PHASE_PRINT,
+  BIB_PHASE_COUNT,
+} BIBStatsPhase;
+
+// What --stats reports. Times are in microseconds. The counters are updated
+// with bib_stats_add, from any thread.
+struct BIBStats {
+  BIBStatsFormat format;
+  gint64 wall[BIB_PHASE_COUNT];
+  gint64 cpu[BIB_PHASE_COUNT];
+  gsize entries;
+  gsize fields;
+  gsize bytes_in;
+  gsize bytes_out;
+  gsize normalized;
+  gsize duplicates;
+  gsize declined;
+  gsize arena_blocks;
+  gsize arena_bytes;
+  gsize sink_blocks;
+};
+
+struct BIBStatsTimer {
+  gint64 wall;
+  gint64 cpu;
+};
+
+// What goes around the printed entries: `open` before all of them, `separator`
+// between two, `terminator` after each one and `close` after all of them.
+struct BIBOutputFrame {
+  const gchar *open;
+  const gchar *separator;
+  const gchar *terminator;
+  const gchar *close;
 };
 
-typedef GPtrArray BIBEntryList;
+typedef struct BIBArena BIBArena;
+typedef struct BIBSink BIBSink;
+typedef struct BIBEntryList BIBEntryList;
 typedef struct BIBEntry BIBEntry;
+typedef struct BIBField BIBField;
+typedef struct BIBFieldInfo BIBFieldInfo;
+typedef struct BIBTypeInfo BIBTypeInfo;
+typedef struct BIBString BIBString;
+typedef struct BIBSplitter BIBSplitter;
+typedef struct BIBSpan BIBSpan;
+typedef struct BIBStatsTimer BIBStatsTimer;
+typedef struct BIBOutputFrame BIBOutputFrame;
+
+#define bib_string_literal(S) bib_string_view(S, sizeof(S) - 1)
+#define bib_string_args(S) (int)(S)->len, (S)->str
+
+// Entries with up to this many fields are printed without allocating.
+#define BIB_PRINT_STACK_FIELDS 32
+
+#define bib_stats_add(COUNTER, N)                            \
+  G_STMT_START {                                             \
+    if (G_UNLIKELY(bib_stats.format != BIB_STATS_OFF)) {     \
+      g_atomic_pointer_add(&bib_stats.COUNTER, (gssize)(N)); \
+    }                                                        \
+  }                                                          \
+  G_STMT_END
 
 ////////////////////////////////////////////////////////////////////////////////
 ///                                                                          ///
@@ -48,19 +254,122 @@ typedef struct BIBEntry BIBEntry;
 ///                                                                          ///
 ////////////////////////////////////////////////////////////////////////////////
 
-struct options parse_options(int argc, char **argv);
+struct options bib_parse_options(int argc, char **argv);
+
+GInputStream *bib_file_open(const gchar *path, GError **error);
+GBytes *bib_file_read(const gchar *path, GError **error);
+
+BIBCompression bib_compression_detect(const guint8 *data, gsize length);
+gboolean bib_compression_parse(const gchar *name, const gchar *output, BIBCompression *compression);
+GInputStream *bib_decompress_input(GInputStream *in, GError **error);
+GOutputStream *bib_compress_output(GOutputStream *out, BIBCompression compression, GError **error);
 
-BIBEntryList *bib_parse(const GString *bibfile, GError **error);
+TSParser *bib_parser(void);
+TSPoint bib_advance_point(const gchar *source, gsize *position, TSPoint point, gsize target);
+void bib_parse_type(BIBEntry *entry, BIBString type);
+void bib_parse_key(BIBEntry *entry, BIBString key);
+void bib_parse_field(BIBEntry *entry, BIBString name, const gchar *value, gsize length, guint64 *year, guint64 *month);
+void bib_parse_date(BIBEntry *entry, guint64 year, guint64 month);
+BIBEntry *bib_parse_entry(TSTreeCursor *cursor, const gchar *source, BIBArena *arena, GError **error);
+void bib_parse_set_fast_scan(gboolean enable);
+BIBEntryList *bib_parse(GBytes *bibfile, guint jobs, GError **error);
+BIBEntryList *bib_parse_unsorted(GBytes *bibfile, guint jobs, GError **error);
+BIBEntryList *bib_parse_cited(GBytes *bibfile, GHashTable *keys, guint jobs, GError **error);
+GArray *bib_scan_entries(const gchar *text, gsize length);
+GArray *bib_fast_split(const gchar *text, gsize length);
+BIBEntry *bib_fast_parse_entry(const gchar *text, const BIBSpan *span, BIBArena *arena);
+GHashTable *bib_cite_keys(gchar **keys, gchar **files, GError **error);
+BIBEntryList *bib_entry_list_cited(BIBEntryList *list, GHashTable *keys);
+BIBEntryList *bib_merge(GPtrArray *sources, guint match, BIBMergePolicy policy, guint jobs, GError **error);
+void bib_entry_list_sort(BIBEntryList *list, guint jobs);
 
-BIBEntry *bib_entry_create(void);
+gchar *bib_cache_path(const gchar *dir, GBytes *contents);
+BIBEntryList *bib_cache_load(GBytes *cache, GError **error);
+gboolean bib_cache_save(const gchar *path, BIBEntryList *list, GError **error);
+
+BIBString bib_string_view(const gchar *str, gsize len);
+BIBString bib_string_take(gchar *str);
+BIBString bib_string_pending(const gchar *str, gsize len);
+BIBString bib_string_resolve(const BIBString *string);
+void bib_string_clear(BIBString *string);
+gchar *bib_string_dup(const BIBString *string);
+gboolean bib_string_equal(const BIBString *a, const BIBString *b);
+guint bib_string_hash(const BIBString *string);
+gboolean bib_string_caseeq(const BIBString *string, const gchar *literal);
+gint bib_string_casecmp(const BIBString *a, const BIBString *b);
+void bib_string_down(BIBString *string);
+
+BIBString bib_normalize(const gchar *text, gsize length);
+
+BIBArena *bib_arena_new(void);
+gpointer bib_arena_alloc(BIBArena *arena, gsize size);
+BIBString bib_arena_string(BIBArena *arena, BIBString string);
+void bib_arena_stats(const BIBArena *arena, gsize *blocks, gsize *allocated);
+void bib_arena_free(gpointer arena);
+
+BIBEntry *bib_entry_create(BIBArena *arena);
 BIBEntryList *bib_entry_list_create(void);
-void bib_entry_free(gpointer entry);
+void bib_entry_list_add_arena(BIBEntryList *list, BIBArena *arena);
+extern const BIBFieldInfo bib_fields[BIB_FIELD_KNOWN];
+gint bib_field_lookup(const BIBString *name);
+const BIBTypeInfo *bib_type_lookup(const BIBString *name);
+
+guint bib_field_intern(const BIBString *name);
+const BIBString *bib_field_name(guint id);
+guint bib_field_to_biblatex(guint id);
+guint bib_field_to_bibtex(guint id);
+guint bib_field_flags(guint id);
+gint bib_field_compare(guint a, guint b);
+
+void bib_entry_set(BIBEntry *entry, guint id, BIBString value);
+const BIBString *bib_entry_get(BIBEntry *entry, guint id);
 void bib_entry_list_free(gpointer list);
 
-GString *bib_entry_print(BIBEntry *entry, gboolean bibtex);
-GString *bib_entry_list_print(BIBEntryList *list, gboolean bibtex);
+BIBSink *bib_sink_new(void);
+BIBSink *bib_sink_new_fd(gint fd);
+BIBSink *bib_sink_new_stream(GOutputStream *stream);
+void bib_sink_append(BIBSink *sink, const gchar *data, gsize length);
+void bib_sink_fill(BIBSink *sink, gchar c, gsize count);
+void bib_sink_printf(BIBSink *sink, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
+void bib_sink_splice(BIBSink *sink, BIBSink *source);
+void bib_sink_flush(BIBSink *sink);
+GBytes *bib_sink_free_to_bytes(BIBSink *sink);
+gboolean bib_sink_close(BIBSink *sink, GError **error);
+void bib_sink_free(gpointer sink);
+
+guint bib_entry_print_fields(BIBEntry *entry, gboolean bibtex, guint *order, gsize *max_length);
+BIBString bib_entry_print_type(BIBEntry *entry);
+gboolean bib_date_split(const BIBString *date, guint64 *year, guint64 *month);
+void bib_entry_print(BIBSink *sink, BIBEntry *entry, gboolean bibtex);
+void bib_entry_print_json(BIBSink *sink, BIBEntry *entry, gboolean bibtex);
+void bib_entry_print_csl(BIBSink *sink, BIBEntry *entry);
+gboolean bib_output_format_parse(const gchar *name, BIBOutputFormat *format);
+const BIBOutputFrame *bib_output_frame(BIBOutputFormat format);
+GBytes *bib_entry_format(BIBEntry *entry, BIBOutputFormat format, gboolean bibtex);
+void bib_entry_list_print(BIBSink *sink, BIBEntryList *list, BIBOutputFormat format, gboolean bibtex, guint jobs);
+
+void bib_splitter_scan(BIBSplitter *splitter, const gchar *text, gsize length);
+void bib_splitter_consume(BIBSplitter *splitter, gsize length);
+gboolean bib_stream_convert(GInputStream *in, BIBSink *out, gsize chunk_size, BIBOutputFormat format, gboolean bibtex, guint jobs, GError **error);
+
+gboolean bib_batch_convert(const struct options *options);
+gboolean bib_watch(const gchar *path, const struct options *options);
+gboolean bib_daemon_serve(const struct options *options);
+gboolean bib_daemon_request(const gchar *input, const struct options *options);
+
+extern struct BIBStats bib_stats;
+void bib_stats_enable(BIBStatsFormat format);
+void bib_stats_start(BIBStatsTimer *timer);
+void bib_stats_stop(BIBStatsTimer *timer, BIBStatsPhase phase);
+void bib_stats_report(void);
+
+void bib_parallel_for(gpointer tasks, gsize count, gsize size, GFunc func, gpointer user_data, guint jobs);
 
-void free_regex(void);
+void bib_free_regex(void);
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(BIBEntry, bib_entry_free)
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(BIBString, bib_string_clear)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(BIBArena, bib_arena_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(BIBSink, bib_sink_free)
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(BIBEntryList, bib_entry_list_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(TSTree, ts_tree_delete)
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(TSTreeCursor, ts_tree_cursor_delete)
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+// Calls `func` on every element of `tasks`, an array of `count` elements of
+// `size` bytes each, spread over up to `jobs` threads. Returns once all of
+// them are done. With a single job everything runs on the calling thread.
+void bib_parallel_for(gpointer tasks, gsize count, gsize size, GFunc func, gpointer user_data, guint jobs) {
+  if (jobs <= 1 || count <= 1) {
+    for (gsize i = 0; i < count; i++) {
+      func((gchar *)tasks + i * size, user_data);
+    }
+    return;
+  }
+
+  GThreadPool *pool = g_thread_pool_new(func, user_data, MIN(jobs, count), FALSE, NULL);
+
+  for (gsize i = 0; i < count; i++) {
+    g_thread_pool_push(pool, (gchar *)tasks + i * size, NULL);
+  }
+
+  g_thread_pool_free(pool, FALSE, TRUE);
+}
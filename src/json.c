@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// JSON output, written straight from the entries into the sink. Each entry is
+// one object on one line, so --format=ndjson is a record per line and
+// --format=csl-json an array of them.
+//
+// Values are given as text rather than BibTeX: the outer braces or quotes,
+// grouping braces and the backslashes escaping special characters are removed.
+// Other LaTeX is kept as it is. NDJSON has the fields the .bib output would
+// have, under the same names; CSL-JSON maps the ones CSL has a variable for.
+
+enum csl_kind {
+  CSL_TEXT,
+  CSL_NAMES,
+  CSL_DATE,
+};
+
+// A CSL variable is taken from the first field in the table that has a value.
+static const struct {
+  guint field;
+  const gchar *name;
+  enum csl_kind kind;
+} csl_fields[] = {
+    {BIB_FIELD_AUTHOR,       "author",            CSL_NAMES},
+    {BIB_FIELD_EDITOR,       "editor",            CSL_NAMES},
+    {BIB_FIELD_TRANSLATOR,   "translator",        CSL_NAMES},
+    {BIB_FIELD_BOOKAUTHOR,   "container-author",  CSL_NAMES},
+    {BIB_FIELD_TITLE,        "title",             CSL_TEXT },
+    {BIB_FIELD_JOURNALTITLE, "container-title",   CSL_TEXT },
+    {BIB_FIELD_BOOKTITLE,    "container-title",   CSL_TEXT },
+    {BIB_FIELD_SERIES,       "collection-title",  CSL_TEXT },
+    {BIB_FIELD_EVENTTITLE,   "event-title",       CSL_TEXT },
+    {BIB_FIELD_VENUE,        "event-place",       CSL_TEXT },
+    {BIB_FIELD_VOLUME,       "volume",            CSL_TEXT },
+    {BIB_FIELD_VOLUMES,      "number-of-volumes", CSL_TEXT },
+    {BIB_FIELD_ISSUE,        "issue",             CSL_TEXT },
+    {BIB_FIELD_NUMBER,       "number",            CSL_TEXT },
+    {BIB_FIELD_CHAPTER,      "chapter-number",    CSL_TEXT },
+    {BIB_FIELD_PAGES,        "page",              CSL_TEXT },
+    {BIB_FIELD_PAGETOTAL,    "number-of-pages",   CSL_TEXT },
+    {BIB_FIELD_EDITION,      "edition",           CSL_TEXT },
+    {BIB_FIELD_VERSION,      "version",           CSL_TEXT },
+    {BIB_FIELD_DATE,         "issued",            CSL_DATE },
+    {BIB_FIELD_EVENTDATE,    "event-date",        CSL_DATE },
+    {BIB_FIELD_ORIGDATE,     "original-date",     CSL_DATE },
+    {BIB_FIELD_URLDATE,      "accessed",          CSL_DATE },
+    {BIB_FIELD_PUBLISHER,    "publisher",         CSL_TEXT },
+    {BIB_FIELD_INSTITUTION,  "publisher",         CSL_TEXT },
+    {BIB_FIELD_SCHOOL,       "publisher",         CSL_TEXT },
+    {BIB_FIELD_ORGANIZATION, "publisher",         CSL_TEXT },
+    {BIB_FIELD_LOCATION,     "publisher-place",   CSL_TEXT },
+    {BIB_FIELD_TYPE,         "genre",             CSL_TEXT },
+    {BIB_FIELD_DOI,          "DOI",               CSL_TEXT },
+    {BIB_FIELD_URL,          "URL",               CSL_TEXT },
+    {BIB_FIELD_ISBN,         "ISBN",              CSL_TEXT },
+    {BIB_FIELD_ISSN,         "ISSN",              CSL_TEXT },
+    {BIB_FIELD_LANGUAGE,     "language",          CSL_TEXT },
+    {BIB_FIELD_LANGID,       "language",          CSL_TEXT },
+    {BIB_FIELD_NOTE,         "note",              CSL_TEXT },
+};
+
+static const struct {
+  const gchar *type;
+  const gchar *csl;
+} csl_types[] = {
+    {"article",       "article-journal" },
+    {"book",          "book"            },
+    {"mvbook",        "book"            },
+    {"collection",    "book"            },
+    {"proceedings",   "book"            },
+    {"inbook",        "chapter"         },
+    {"bookinbook",    "chapter"         },
+    {"incollection",  "chapter"         },
+    {"inproceedings", "paper-conference"},
+    {"thesis",        "thesis"          },
+    {"report",        "report"          },
+    {"manual",        "report"          },
+    {"online",        "webpage"         },
+    {"patent",        "patent"          },
+    {"periodical",    "periodical"      },
+    {"dataset",       "dataset"         },
+    {"software",      "software"        },
+    {"booklet",       "pamphlet"        },
+    {"unpublished",   "manuscript"      },
+};
+
+static void json_append(BIBSink *sink, const gchar *text) {
+  bib_sink_append(sink, text, strlen(text));
+}
+
+// Writes `text` as a JSON string. Bytes that are not valid UTF-8 become
+// U+FFFD, so the output is valid JSON whatever the input was.
+static void json_string(BIBSink *sink, const gchar *text, gsize length) {
+  gsize start = 0;
+  gsize i = 0;
+
+  bib_sink_append(sink, "\"", 1);
+
+  while (i < length) {
+    guchar c = text[i];
+    gchar buffer[8];
+    const gchar *escape = NULL;
+
+    if (c >= 0x80) {
+      gunichar u = g_utf8_get_char_validated(text + i, length - i);
+      if (u != (gunichar)-1 && u != (gunichar)-2) {
+        i += g_utf8_skip[c];
+        continue;
+      }
+      escape = "\\ufffd";
+    } else if (c == '"') {
+      escape = "\\\"";
+    } else if (c == '\\') {
+      escape = "\\\\";
+    } else if (c == '\n') {
+      escape = "\\n";
+    } else if (c == '\t') {
+      escape = "\\t";
+    } else if (c == '\r') {
+      escape = "\\r";
+    } else if (c < 0x20) {
+      g_snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      escape = buffer;
+    } else {
+      i++;
+      continue;
+    }
+
+    bib_sink_append(sink, text + start, i - start);
+    json_append(sink, escape);
+    start = ++i;
+  }
+
+  bib_sink_append(sink, text + start, length - start);
+  bib_sink_append(sink, "\"", 1);
+}
+
+// Whether the brace at the start of `text` is closed by its last byte.
+static gboolean braced(const gchar *text, gsize length) {
+  gsize depth = 0;
+
+  if (length < 2 || text[0] != '{' || text[length - 1] != '}') {
+    return FALSE;
+  }
+
+  for (gsize i = 0; i < length; i++) {
+    if (text[i] == '\\') {
+      i++;
+    } else if (text[i] == '{') {
+      depth++;
+    } else if (text[i] == '}' && --depth == 0) {
+      return i == length - 1;
+    }
+  }
+
+  return FALSE;
+}
+
+static void trim(const gchar **text, gsize *length) {
+  while (*length > 0 && g_ascii_isspace(**text)) {
+    (*text)++;
+    (*length)--;
+  }
+
+  while (*length > 0 && g_ascii_isspace((*text)[*length - 1])) {
+    (*length)--;
+  }
+}
+
+// Strips the outer braces or quotes of a field value.
+static void unwrap(const gchar **text, gsize *length) {
+  trim(text, length);
+
+  if (braced(*text, *length) || (*length >= 2 && (*text)[0] == '"' && (*text)[*length - 1] == '"')) {
+    (*text)++;
+    *length -= 2;
+  }
+}
+
+// Replaces the contents of `out` with `text` as plain text.
+static void plain_text(GString *out, const gchar *text, gsize length) {
+  g_string_truncate(out, 0);
+  unwrap(&text, &length);
+
+  for (gsize i = 0; i < length; i++) {
+    gchar c = text[i];
+
+    if (c == '{' || c == '}') {
+      continue;
+    }
+
+    if (c == '\\' && i + 1 < length && text[i + 1] != '\0' && strchr("&%$#_{}", text[i + 1]) != NULL) {
+      c = text[++i];
+    }
+
+    g_string_append_c(out, c);
+  }
+}
+
+static void json_text(BIBSink *sink, GString *scratch, const gchar *text, gsize length) {
+  plain_text(scratch, text, length);
+  json_string(sink, scratch->str, scratch->len);
+}
+
+static void json_key(BIBSink *sink, const gchar *name, gsize length, gboolean first) {
+  if (!first) {
+    bib_sink_append(sink, ", ", 2);
+  }
+
+  json_string(sink, name, length);
+  bib_sink_append(sink, ": ", 2);
+}
+
+void bib_entry_print_json(BIBSink *sink, BIBEntry *entry, gboolean bibtex) {
+  BIBString type = bibtex ? bib_entry_print_type(entry) : entry->type;
+  g_autoptr(GString) scratch = g_string_new(NULL);
+
+  json_append(sink, "{\"type\": ");
+  json_string(sink, type.str, type.len);
+  json_append(sink, ", \"key\": ");
+  json_string(sink, entry->key.str, entry->key.len);
+  json_append(sink, ", \"fields\": {");
+
+  guint stack_order[BIB_PRINT_STACK_FIELDS];
+  g_autofree guint *heap_order = entry->n_fields > BIB_PRINT_STACK_FIELDS ? g_new(guint, entry->n_fields) : NULL;
+  guint *order = heap_order != NULL ? heap_order : stack_order;
+  gsize max_length = 0;
+  guint n_order = bib_entry_print_fields(entry, bibtex, order, &max_length);
+  gboolean first = TRUE;
+
+  for (guint i = 0; i < n_order; i++) {
+    const BIBField *field = &entry->fields[order[i]];
+    guint id = bibtex ? bib_field_to_bibtex(field->id) : field->id;
+    g_auto(BIBString) value = bib_string_resolve(&field->value);
+
+    // BibTeX has no date, it gets year and month as in the .bib output.
+    if (bibtex && id == BIB_FIELD_DATE) {
+      guint64 year = 0;
+      guint64 month = 0;
+
+      if (bib_date_split(&value, &year, &month) && year > 0) {
+        json_key(sink, "year", strlen("year"), first);
+        bib_sink_printf(sink, "\"%lu\"", year);
+        first = FALSE;
+      }
+
+      if (month > 0) {
+        json_key(sink, "month", strlen("month"), first);
+        bib_sink_printf(sink, "\"%lu\"", month);
+        first = FALSE;
+      }
+      continue;
+    }
+
+    const BIBString *name = bib_field_name(id);
+    json_key(sink, name->str, name->len, first);
+    json_text(sink, scratch, value.str, value.len);
+    first = FALSE;
+  }
+
+  json_append(sink, "}}");
+}
+
+// Splits `text` at `separator`, outside of braces. Returns the length of the
+// first part, or `length` when the separator is not there.
+static gsize split_top(const gchar *text, gsize length, const gchar *separator) {
+  gsize separator_length = strlen(separator);
+  gsize depth = 0;
+
+  for (gsize i = 0; i < length; i++) {
+    if (text[i] == '\\') {
+      i++;
+    } else if (text[i] == '{') {
+      depth++;
+    } else if (text[i] == '}' && depth > 0) {
+      depth--;
+    } else if (depth == 0 && i + separator_length <= length && g_ascii_strncasecmp(text + i, separator, separator_length) == 0) {
+      return i;
+    }
+  }
+
+  return length;
+}
+
+// The last space outside of braces, or `length` when there is none.
+static gsize last_space(const gchar *text, gsize length) {
+  gsize depth = 0;
+  gsize space = length;
+
+  for (gsize i = 0; i < length; i++) {
+    if (text[i] == '\\') {
+      i++;
+    } else if (text[i] == '{') {
+      depth++;
+    } else if (text[i] == '}' && depth > 0) {
+      depth--;
+    } else if (depth == 0 && text[i] == ' ') {
+      space = i;
+    }
+  }
+
+  return space;
+}
+
+// Names are "Family, Given", "Family, Suffix, Given" or "Given Family". A name
+// wholly in braces, such as {World Health Organization}, is a literal.
+static void csl_name(BIBSink *sink, GString *scratch, const gchar *text, gsize length) {
+  trim(&text, &length);
+
+  if (braced(text, length)) {
+    json_append(sink, "{\"literal\": ");
+    json_text(sink, scratch, text, length);
+    json_append(sink, "}");
+    return;
+  }
+
+  gsize comma = split_top(text, length, ",");
+
+  if (comma == length) {
+    gsize space = last_space(text, length);
+
+    if (space == length) {
+      json_append(sink, "{\"family\": ");
+      json_text(sink, scratch, text, length);
+    } else {
+      json_append(sink, "{\"family\": ");
+      json_text(sink, scratch, text + space + 1, length - space - 1);
+      json_append(sink, ", \"given\": ");
+      json_text(sink, scratch, text, space);
+    }
+
+    json_append(sink, "}");
+    return;
+  }
+
+  const gchar *rest = text + comma + 1;
+  gsize rest_length = length - comma - 1;
+  gsize second = split_top(rest, rest_length, ",");
+
+  json_append(sink, "{\"family\": ");
+  json_text(sink, scratch, text, comma);
+
+  if (second < rest_length) {
+    json_append(sink, ", \"suffix\": ");
+    json_text(sink, scratch, rest, second);
+    rest += second + 1;
+    rest_length -= second + 1;
+  }
+
+  json_append(sink, ", \"given\": ");
+  json_text(sink, scratch, rest, rest_length);
+  json_append(sink, "}");
+}
+
+static void csl_names(BIBSink *sink, GString *scratch, const gchar *text, gsize length) {
+  unwrap(&text, &length);
+  bib_sink_append(sink, "[", 1);
+
+  for (gboolean first = TRUE; length > 0; first = FALSE) {
+    gsize end = split_top(text, length, " and ");
+
+    if (!first) {
+      bib_sink_append(sink, ", ", 2);
+    }
+
+    csl_name(sink, scratch, text, end);
+
+    gsize skip = MIN(end + strlen(" and "), length);
+    text += skip;
+    length -= skip;
+  }
+
+  bib_sink_append(sink, "]", 1);
+}
+
+// Dates are biblatex's ISO 8601 dates, possibly ranges. Anything else is kept
+// as a literal.
+static void csl_date(BIBSink *sink, GString *scratch, const gchar *text, gsize length) {
+  plain_text(scratch, text, length);
+
+  g_auto(GStrv) ends = g_strsplit(scratch->str, "/", 2);
+  GString *parts = g_string_new(NULL);
+
+  for (gchar **end = ends; *end != NULL; end++) {
+    guint year = 0;
+    guint month = 0;
+    guint day = 0;
+    gint n = sscanf(*end, "%u-%u-%u", &year, &month, &day);
+
+    if (n < 1) {
+      continue;
+    }
+
+    g_string_append_printf(parts, "%s[%u", parts->len > 0 ? ", " : "", year);
+    if (n >= 2) {
+      g_string_append_printf(parts, ", %u", month);
+    }
+    if (n >= 3) {
+      g_string_append_printf(parts, ", %u", day);
+    }
+    g_string_append_c(parts, ']');
+  }
+
+  if (parts->len > 0) {
+    bib_sink_printf(sink, "{\"date-parts\": [%s]}", parts->str);
+  } else {
+    json_append(sink, "{\"literal\": ");
+    json_string(sink, scratch->str, scratch->len);
+    json_append(sink, "}");
+  }
+
+  g_string_free(parts, TRUE);
+}
+
+static const gchar *csl_type(BIBEntry *entry) {
+  for (gsize i = 0; i < G_N_ELEMENTS(csl_types); i++) {
+    if (bib_string_caseeq(&entry->type, csl_types[i].type)) {
+      return csl_types[i].csl;
+    }
+  }
+
+  return "document";
+}
+
+void bib_entry_print_csl(BIBSink *sink, BIBEntry *entry) {
+  const gchar *type = csl_type(entry);
+  const gchar *written[G_N_ELEMENTS(csl_fields)];
+  gsize n_written = 0;
+  g_autoptr(GString) scratch = g_string_new(NULL);
+
+  json_append(sink, "{\"id\": ");
+  json_string(sink, entry->key.str, entry->key.len);
+  json_append(sink, ", \"type\": ");
+  json_string(sink, type, strlen(type));
+
+  for (gsize i = 0; i < G_N_ELEMENTS(csl_fields); i++) {
+    const BIBString *field = bib_entry_get(entry, csl_fields[i].field);
+    const gchar *name = csl_fields[i].name;
+
+    // biblatex's number is the issue of a journal.
+    if (csl_fields[i].field == BIB_FIELD_NUMBER && g_str_equal(type, "article-journal")) {
+      name = "issue";
+    }
+
+    if (field == NULL) {
+      continue;
+    }
+
+    gboolean seen = FALSE;
+    for (gsize j = 0; j < n_written && !seen; j++) {
+      seen = g_str_equal(written[j], name);
+    }
+
+    if (seen) {
+      continue;
+    }
+
+    written[n_written++] = name;
+
+    g_auto(BIBString) value = bib_string_resolve(field);
+    json_key(sink, name, strlen(name), FALSE);
+
+    switch (csl_fields[i].kind) {
+    case CSL_NAMES:
+      csl_names(sink, scratch, value.str, value.len);
+      break;
+    case CSL_DATE:
+      csl_date(sink, scratch, value.str, value.len);
+      break;
+    default:
+      json_text(sink, scratch, value.str, value.len);
+      break;
+    }
+  }
+
+  bib_sink_append(sink, "}", 1);
+}
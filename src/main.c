@@ -15,7 +15,12 @@
  */
 
 #include "internal.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
 #include <locale.h>
+#include <unistd.h>
 
 static void printVersion(void) {
   static const gchar *path = "/me/acristoffers/remove-trash/version";
@@ -25,43 +30,132 @@ static void printVersion(void) {
   g_print("%s", raw_data);
 }
 
-GString *file_read(const gchar *path, GError **error) {
-  g_autoptr(GError) fn_error = NULL;
-  g_autoptr(GFile) file = g_file_new_for_commandline_arg(path);
-  g_autoptr(GFileInputStream) in = g_file_read(file, NULL, &fn_error);
+// Output goes to stdout unless a file was given with -o. The file is written
+// under a temporary name next to it and only replaces it once everything was
+// written: the input may be the same file, mapped, and a failed conversion
+// must not leave half a file behind.
+struct output {
+  gint fd;
+  gchar *path;
+  gchar *temp_path;
+};
 
-  if (fn_error != NULL) {
-    g_propagate_error(error, fn_error);
-    return NULL;
+static gboolean output_open(const gchar *path, struct output *output) {
+  *output = (struct output){.fd = STDOUT_FILENO};
+
+  if (path == NULL) {
+    return TRUE;
+  }
+
+  g_autofree gchar *dir = g_path_get_dirname(path);
+  g_autofree gchar *name = g_path_get_basename(path);
+  g_autofree gchar *template = g_strdup_printf(".%s.XXXXXX", name);
+  gchar *temp_path = g_build_filename(dir, template, NULL);
+  gint fd = g_mkstemp_full(temp_path, O_WRONLY, 0644);
+
+  if (fd < 0) {
+    g_printerr("Error writing file: %s: %s\n", path, g_strerror(errno));
+    g_free(temp_path);
+    return FALSE;
   }
 
-  GString *contents = g_string_new(NULL);
-  gchar buffer[4096];
-  gssize length;
+  output->fd = fd;
+  output->path = g_strdup(path);
+  output->temp_path = temp_path;
+  return TRUE;
+}
+
+// Drops the temporary file, for when the conversion failed.
+static void output_abort(struct output *output, BIBSink *out) {
+  bib_sink_free(out);
+
+  if (output->temp_path != NULL) {
+    g_close(output->fd, NULL);
+    g_unlink(output->temp_path);
+  }
+
+  g_free(output->path);
+  g_free(output->temp_path);
+}
 
-  while ((length = g_input_stream_read(G_INPUT_STREAM(in), buffer, sizeof(buffer), NULL, &fn_error)) > 0) {
-    g_string_append_len(contents, buffer, length);
+// Compressed output goes through a converter stream, anything else straight
+// to the descriptor.
+static BIBSink *output_sink(gint fd, BIBCompression compression) {
+  if (compression == BIB_COMPRESSION_NONE) {
+    return bib_sink_new_fd(fd);
   }
 
-  if (fn_error != NULL) {
-    g_propagate_error(error, fn_error);
-    g_string_free(contents, TRUE);
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOutputStream) raw = g_unix_output_stream_new(fd, FALSE);
+  g_autoptr(GOutputStream) out = bib_compress_output(raw, compression, &error);
+
+  if (out == NULL) {
+    g_printerr("Error writing file: %s\n", error->message);
     return NULL;
   }
 
-  return contents;
+  return bib_sink_new_stream(out);
+}
+
+static gboolean output_close(struct output *output, BIBSink *out) {
+  g_autoptr(GError) error = NULL;
+  gboolean ok = bib_sink_close(out, &error);
+
+  if (output->temp_path == NULL) {
+    if (!ok) {
+      g_printerr("Error writing file: %s\n", error->message);
+    }
+    return ok;
+  }
+
+  if (!g_close(output->fd, ok ? &error : NULL)) {
+    ok = FALSE;
+  }
+
+  if (ok && g_rename(output->temp_path, output->path) != 0) {
+    g_set_error(&error, G_FILE_ERROR, g_file_error_from_errno(errno), "%s: %s", output->path, g_strerror(errno));
+    ok = FALSE;
+  }
+
+  if (!ok) {
+    g_printerr("Error writing file: %s\n", error->message);
+    g_unlink(output->temp_path);
+  }
+
+  g_free(output->path);
+  g_free(output->temp_path);
+  return ok;
 }
 
 int main(int argc, char **argv) {
   setlocale(LC_ALL, "en_US.UTF-8");
 
-  struct options options = parse_options(argc, argv);
+  struct options options = bib_parse_options(argc, argv);
 
   if (options.version) {
     printVersion();
     return 0;
   }
 
+  if (options.batch || options.files_from != NULL) {
+    gboolean ok = bib_batch_convert(&options);
+    bib_stats_report();
+
+    g_strfreev(options.rest);
+    bib_free_regex();
+
+    return ok ? 0 : 1;
+  }
+
+  if (options.daemon) {
+    gboolean ok = bib_daemon_serve(&options);
+
+    g_strfreev(options.rest);
+    bib_free_regex();
+
+    return ok ? 0 : 1;
+  }
+
   if (g_strv_length(options.rest) < 1) {
     g_printerr("Missing bib file in arguments.\n");
     return 1;
@@ -70,25 +164,177 @@ int main(int argc, char **argv) {
   const gchar *path = options.rest[0];
 
   g_autoptr(GError) error = NULL;
-  g_autoptr(GString) contents = file_read(path, &error);
 
-  if (error != NULL) {
-    g_printerr("Error reading file: %s", error->message);
-    return 1;
+  if (options.client) {
+    gboolean ok = bib_daemon_request(path, &options);
+
+    g_strfreev(options.rest);
+    bib_free_regex();
+
+    return ok ? 0 : 1;
+  }
+
+  if (options.watch) {
+    gboolean ok = bib_watch(path, &options);
+
+    g_strfreev(options.rest);
+    bib_free_regex();
+
+    return ok ? 0 : 1;
+  }
+
+  if (options.stream) {
+    g_autoptr(GInputStream) in = bib_file_open(path, &error);
+
+    if (error != NULL) {
+      g_printerr("Error reading file: %s", error->message);
+      return 1;
+    }
+
+    struct output output;
+
+    if (!output_open(options.output, &output)) {
+      return 1;
+    }
+
+    BIBSink *out = output_sink(output.fd, options.compression);
+
+    if (out == NULL) {
+      output_abort(&output, NULL);
+      return 1;
+    }
+
+    gboolean ok = bib_stream_convert(in, out, (gsize)options.chunk_size * 1024 * 1024, options.output_format, options.bibtex, options.jobs, &error);
+
+    if (!ok) {
+      g_printerr("Error: %s\n", error->message);
+      output_abort(&output, out);
+      return 1;
+    }
+
+    if (!output_close(&output, out)) {
+      return 1;
+    }
+
+    bib_stats_report();
+
+    g_strfreev(options.rest);
+    bib_free_regex();
+
+    return 0;
+  }
+
+  // With --merge every file given is an input, otherwise only the first one.
+  // Parsed entries point into these, so they are kept until the end.
+  guint n_sources = options.merge ? g_strv_length(options.rest) : 1;
+  g_autoptr(GPtrArray) sources = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+
+  for (guint i = 0; i < n_sources; i++) {
+    GBytes *contents = bib_file_read(options.rest[i], &error);
+
+    if (error != NULL) {
+      g_printerr("Error reading file: %s", error->message);
+      return 1;
+    }
+
+    g_ptr_array_add(sources, contents);
+  }
+
+  GBytes *contents = g_ptr_array_index(sources, 0);
+
+  g_autoptr(GHashTable) keys = NULL;
+
+  if (options.cite != NULL || options.cite_files != NULL) {
+    keys = bib_cite_keys(options.cite, options.cite_files, &error);
+
+    if (error != NULL) {
+      g_printerr("Error reading citations: %s\n", error->message);
+      return 1;
+    }
+  }
+
+  // Entries loaded from the cache point into the mapping, so it must be kept
+  // alive until they have been printed.
+  g_autofree gchar *cache_path = options.no_cache || options.merge ? NULL : bib_cache_path(options.cache_dir, contents);
+  g_autoptr(GMappedFile) cache = cache_path != NULL ? g_mapped_file_new(cache_path, FALSE, NULL) : NULL;
+  g_autoptr(BIBEntryList) entries = NULL;
+
+  if (cache != NULL) {
+    BIBStatsTimer timer;
+    bib_stats_start(&timer);
+    g_autoptr(GBytes) bytes = g_mapped_file_get_bytes(cache);
+    entries = bib_cache_load(bytes, NULL);
+    bib_stats_stop(&timer, BIB_PHASE_CACHE);
+
+    if (entries != NULL) {
+      bib_stats_add(entries, entries->entries->len);
+    }
   }
 
-  g_autoptr(BIBEntryList) entries = bib_parse(contents, &error);
+  if (options.merge) {
+    entries = bib_merge(sources, options.merge_match, options.merge_policy, options.jobs, &error);
+
+    if (entries != NULL && keys != NULL) {
+      g_autoptr(BIBEntryList) all = g_steal_pointer(&entries);
+      entries = bib_entry_list_cited(all, keys);
+    }
+  } else if (entries != NULL && keys != NULL) {
+    g_autoptr(BIBEntryList) all = g_steal_pointer(&entries);
+    entries = bib_entry_list_cited(all, keys);
+  } else if (keys != NULL) {
+    // Only the cited entries get parsed, so there is nothing to cache.
+    entries = bib_parse_cited(contents, keys, options.jobs, &error);
+  } else if (entries == NULL) {
+    entries = bib_parse(contents, options.jobs, &error);
+
+    if (entries != NULL && cache_path != NULL) {
+      g_autoptr(GError) cache_error = NULL;
+      BIBStatsTimer timer;
+      bib_stats_start(&timer);
+
+      if (!bib_cache_save(cache_path, entries, &cache_error)) {
+        g_printerr("Could not write cache: %s\n", cache_error->message);
+      }
+
+      bib_stats_stop(&timer, BIB_PHASE_CACHE);
+    }
+  }
 
   if (error != NULL) {
     g_printerr("Error: %s\n", error->message);
     return 1;
   }
 
-  g_autoptr(GString) formatted = bib_entry_list_print(entries, options.bibtex);
-  g_print("%s\n", formatted->str);
+  struct output output;
+
+  if (!output_open(options.output, &output)) {
+    return 1;
+  }
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+  BIBSink *out = output_sink(output.fd, options.compression);
+
+  if (out == NULL) {
+    output_abort(&output, NULL);
+    return 1;
+  }
+
+  bib_entry_list_print(out, entries, options.output_format, options.bibtex, options.jobs);
+
+  if (options.output_format == BIB_OUTPUT_BIB) {
+    bib_sink_append(out, "\n", 1);
+  }
+
+  if (!output_close(&output, out)) {
+    return 1;
+  }
+
+  bib_stats_stop(&timer, BIB_PHASE_PRINT);
+  bib_stats_report();
 
   g_strfreev(options.rest);
-  free_regex();
+  bib_free_regex();
 
   return 0;
 }
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Generated by tools/gen-mappings.py, do not edit.
+
+#include "internal.h"
+
+#include <string.h>
+
+const BIBFieldInfo bib_fields[BIB_FIELD_KNOWN] = {
+    {{.str = "abstract", .len = 8},         BIB_FIELD_ABSTRACT,        BIB_FIELD_ABSTRACT,        BIB_FIELD_SKIP,          74},
+    {{.str = "addendum", .len = 8},         BIB_FIELD_ADDENDUM,        BIB_FIELD_ADDENDUM,        0,                       67},
+    {{.str = "address", .len = 7},          BIB_FIELD_LOCATION,        BIB_FIELD_ADDRESS,         0,                       48},
+    {{.str = "afterword", .len = 9},        BIB_FIELD_AFTERWORD,       BIB_FIELD_AFTERWORD,       0,                       11},
+    {{.str = "annotation", .len = 10},      BIB_FIELD_ANNOTATION,      BIB_FIELD_ANNOTE,          0,                       73},
+    {{.str = "annotator", .len = 9},        BIB_FIELD_ANNOTATOR,       BIB_FIELD_ANNOTATOR,       0,                       8},
+    {{.str = "annote", .len = 6},           BIB_FIELD_ANNOTATION,      BIB_FIELD_ANNOTE,          0,                       73},
+    {{.str = "archiveprefix", .len = 13},   BIB_FIELD_EPRINTTYPE,      BIB_FIELD_ARCHIVEPREFIX,   0,                       63},
+    {{.str = "author", .len = 6},           BIB_FIELD_AUTHOR,          BIB_FIELD_AUTHOR,          0,                       0},
+    {{.str = "bookauthor", .len = 10},      BIB_FIELD_BOOKAUTHOR,      BIB_FIELD_BOOKAUTHOR,      0,                       5},
+    {{.str = "booksubtitle", .len = 12},    BIB_FIELD_BOOKSUBTITLE,    BIB_FIELD_BOOKSUBTITLE,    0,                       17},
+    {{.str = "booktitle", .len = 9},        BIB_FIELD_BOOKTITLE,       BIB_FIELD_BOOKTITLE,       0,                       16},
+    {{.str = "chapter", .len = 7},          BIB_FIELD_CHAPTER,         BIB_FIELD_CHAPTER,         0,                       32},
+    {{.str = "commentator", .len = 11},     BIB_FIELD_COMMENTATOR,     BIB_FIELD_COMMENTATOR,     0,                       7},
+    {{.str = "crossref", .len = 8},         BIB_FIELD_CROSSREF,        BIB_FIELD_CROSSREF,        0,                       69},
+    {{.str = "date", .len = 4},             BIB_FIELD_DATE,            BIB_FIELD_DATE,            0,                       39},
+    {{.str = "doi", .len = 3},              BIB_FIELD_DOI,             BIB_FIELD_DOI,             0,                       60},
+    {{.str = "edition", .len = 7},          BIB_FIELD_EDITION,         BIB_FIELD_EDITION,         0,                       35},
+    {{.str = "editor", .len = 6},           BIB_FIELD_EDITOR,          BIB_FIELD_EDITOR,          0,                       1},
+    {{.str = "editora", .len = 7},          BIB_FIELD_EDITORA,         BIB_FIELD_EDITORA,         0,                       2},
+    {{.str = "editorb", .len = 7},          BIB_FIELD_EDITORB,         BIB_FIELD_EDITORB,         0,                       3},
+    {{.str = "editorc", .len = 7},          BIB_FIELD_EDITORC,         BIB_FIELD_EDITORC,         0,                       4},
+    {{.str = "eid", .len = 3},              BIB_FIELD_EID,             BIB_FIELD_EID,             0,                       31},
+    {{.str = "eprint", .len = 6},           BIB_FIELD_EPRINT,          BIB_FIELD_EPRINT,          BIB_FIELD_SKIP_WITH_DOI, 61},
+    {{.str = "eprintclass", .len = 11},     BIB_FIELD_EPRINTCLASS,     BIB_FIELD_PRIMARYCLASS,    BIB_FIELD_SKIP_WITH_DOI, 62},
+    {{.str = "eprinttype", .len = 10},      BIB_FIELD_EPRINTTYPE,      BIB_FIELD_ARCHIVEPREFIX,   BIB_FIELD_SKIP_WITH_DOI, 63},
+    {{.str = "eprintype", .len = 9},        BIB_FIELD_EPRINTYPE,       BIB_FIELD_EPRINTYPE,       BIB_FIELD_SKIP_WITH_DOI, 63},
+    {{.str = "eventdate", .len = 9},        BIB_FIELD_EVENTDATE,       BIB_FIELD_EVENTDATE,       0,                       37},
+    {{.str = "eventtitle", .len = 10},      BIB_FIELD_EVENTTITLE,      BIB_FIELD_EVENTTITLE,      0,                       21},
+    {{.str = "file", .len = 4},             BIB_FIELD_FILE,            BIB_FIELD_FILE,            BIB_FIELD_SKIP,          76},
+    {{.str = "foreword", .len = 8},         BIB_FIELD_FOREWORD,        BIB_FIELD_FOREWORD,        0,                       10},
+    {{.str = "holder", .len = 6},           BIB_FIELD_HOLDER,          BIB_FIELD_HOLDER,          0,                       12},
+    {{.str = "howpublished", .len = 12},    BIB_FIELD_HOWPUBLISHED,    BIB_FIELD_HOWPUBLISHED,    0,                       50},
+    {{.str = "indextitle", .len = 10},      BIB_FIELD_INDEXTITLE,      BIB_FIELD_INDEXTITLE,      0,                       22},
+    {{.str = "institution", .len = 11},     BIB_FIELD_INSTITUTION,     BIB_FIELD_INSTITUTION,     0,                       46},
+    {{.str = "introduction", .len = 12},    BIB_FIELD_INTRODUCTION,    BIB_FIELD_INTRODUCTION,    0,                       9},
+    {{.str = "isan", .len = 4},             BIB_FIELD_ISAN,            BIB_FIELD_ISAN,            0,                       57},
+    {{.str = "isbn", .len = 4},             BIB_FIELD_ISBN,            BIB_FIELD_ISBN,            BIB_FIELD_SKIP_WITH_DOI, 55},
+    {{.str = "ismn", .len = 4},             BIB_FIELD_ISMN,            BIB_FIELD_ISMN,            0,                       58},
+    {{.str = "isrn", .len = 4},             BIB_FIELD_ISRN,            BIB_FIELD_ISRN,            0,                       59},
+    {{.str = "issn", .len = 4},             BIB_FIELD_ISSN,            BIB_FIELD_ISSN,            BIB_FIELD_SKIP_WITH_DOI, 56},
+    {{.str = "issue", .len = 5},            BIB_FIELD_ISSUE,           BIB_FIELD_ISSUE,           0,                       30},
+    {{.str = "issuetitle", .len = 10},      BIB_FIELD_ISSUETITLE,      BIB_FIELD_ISSUETITLE,      0,                       20},
+    {{.str = "journal", .len = 7},          BIB_FIELD_JOURNALTITLE,    BIB_FIELD_JOURNAL,         0,                       24},
+    {{.str = "journalsubtitle", .len = 15}, BIB_FIELD_JOURNALSUBTITLE, BIB_FIELD_JOURNALSUBTITLE, 0,                       25},
+    {{.str = "journaltitle", .len = 12},    BIB_FIELD_JOURNALTITLE,    BIB_FIELD_JOURNAL,         0,                       24},
+    {{.str = "key", .len = 3},              BIB_FIELD_SORTKEY,         BIB_FIELD_KEY,             0,                       70},
+    {{.str = "keywords", .len = 8},         BIB_FIELD_KEYWORDS,        BIB_FIELD_KEYWORDS,        BIB_FIELD_SKIP,          75},
+    {{.str = "label", .len = 5},            BIB_FIELD_LABEL,           BIB_FIELD_LABEL,           0,                       71},
+    {{.str = "langid", .len = 6},           BIB_FIELD_LANGID,          BIB_FIELD_LANGID,          0,                       54},
+    {{.str = "language", .len = 8},         BIB_FIELD_LANGUAGE,        BIB_FIELD_LANGUAGE,        0,                       52},
+    {{.str = "library", .len = 7},          BIB_FIELD_LIBRARY,         BIB_FIELD_LIBRARY,         0,                       72},
+    {{.str = "location", .len = 8},         BIB_FIELD_LOCATION,        BIB_FIELD_ADDRESS,         0,                       48},
+    {{.str = "mainsubtitle", .len = 12},    BIB_FIELD_MAINSUBTITLE,    BIB_FIELD_MAINSUBTITLE,    0,                       19},
+    {{.str = "maintitle", .len = 9},        BIB_FIELD_MAINTITLE,       BIB_FIELD_MAINTITLE,       0,                       18},
+    {{.str = "month", .len = 5},            BIB_FIELD_MONTH,           BIB_FIELD_MONTH,           0,                       41},
+    {{.str = "note", .len = 4},             BIB_FIELD_NOTE,            BIB_FIELD_NOTE,            0,                       66},
+    {{.str = "number", .len = 6},           BIB_FIELD_NUMBER,          BIB_FIELD_NUMBER,          0,                       29},
+    {{.str = "organization", .len = 12},    BIB_FIELD_ORGANIZATION,    BIB_FIELD_ORGANIZATION,    0,                       45},
+    {{.str = "origdate", .len = 8},         BIB_FIELD_ORIGDATE,        BIB_FIELD_ORIGDATE,        0,                       42},
+    {{.str = "origlanguage", .len = 12},    BIB_FIELD_ORIGLANGUAGE,    BIB_FIELD_ORIGLANGUAGE,    0,                       53},
+    {{.str = "origlocation", .len = 12},    BIB_FIELD_ORIGLOCATION,    BIB_FIELD_ORIGLOCATION,    0,                       49},
+    {{.str = "origpublisher", .len = 13},   BIB_FIELD_ORIGPUBLISHER,   BIB_FIELD_ORIGPUBLISHER,   0,                       44},
+    {{.str = "pages", .len = 5},            BIB_FIELD_PAGES,           BIB_FIELD_PAGES,           0,                       33},
+    {{.str = "pagetotal", .len = 9},        BIB_FIELD_PAGETOTAL,       BIB_FIELD_PAGETOTAL,       0,                       34},
+    {{.str = "pdf", .len = 3},              BIB_FIELD_PDF,             BIB_FIELD_PDF,             0,                       76},
+    {{.str = "primaryclass", .len = 12},    BIB_FIELD_EPRINTCLASS,     BIB_FIELD_PRIMARYCLASS,    0,                       62},
+    {{.str = "publisher", .len = 9},        BIB_FIELD_PUBLISHER,       BIB_FIELD_PUBLISHER,       0,                       43},
+    {{.str = "pubstate", .len = 8},         BIB_FIELD_PUBSTATE,        BIB_FIELD_PUBSTATE,        0,                       68},
+    {{.str = "school", .len = 6},           BIB_FIELD_SCHOOL,          BIB_FIELD_SCHOOL,          0,                       47},
+    {{.str = "series", .len = 6},           BIB_FIELD_SERIES,          BIB_FIELD_SERIES,          0,                       26},
+    {{.str = "shorthand", .len = 9},        BIB_FIELD_SHORTHAND,       BIB_FIELD_SHORTHAND,       0,                       23},
+    {{.str = "sortkey", .len = 7},          BIB_FIELD_SORTKEY,         BIB_FIELD_KEY,             0,                       70},
+    {{.str = "subtitle", .len = 8},         BIB_FIELD_SUBTITLE,        BIB_FIELD_SUBTITLE,        0,                       14},
+    {{.str = "title", .len = 5},            BIB_FIELD_TITLE,           BIB_FIELD_TITLE,           0,                       13},
+    {{.str = "titleaddon", .len = 10},      BIB_FIELD_TITLEADDON,      BIB_FIELD_TITLEADDON,      0,                       15},
+    {{.str = "translator", .len = 10},      BIB_FIELD_TRANSLATOR,      BIB_FIELD_TRANSLATOR,      0,                       6},
+    {{.str = "type", .len = 4},             BIB_FIELD_TYPE,            BIB_FIELD_TYPE,            0,                       51},
+    {{.str = "url", .len = 3},              BIB_FIELD_URL,             BIB_FIELD_URL,             BIB_FIELD_SKIP_WITH_DOI, 64},
+    {{.str = "urldate", .len = 7},          BIB_FIELD_URLDATE,         BIB_FIELD_URLDATE,         BIB_FIELD_SKIP_WITH_DOI, 65},
+    {{.str = "venue", .len = 5},            BIB_FIELD_VENUE,           BIB_FIELD_VENUE,           0,                       38},
+    {{.str = "version", .len = 7},          BIB_FIELD_VERSION,         BIB_FIELD_VERSION,         0,                       36},
+    {{.str = "volume", .len = 6},           BIB_FIELD_VOLUME,          BIB_FIELD_VOLUME,          0,                       27},
+    {{.str = "volumes", .len = 7},          BIB_FIELD_VOLUMES,         BIB_FIELD_VOLUMES,         0,                       28},
+    {{.str = "year", .len = 4},             BIB_FIELD_YEAR,            BIB_FIELD_YEAR,            0,                       40},
+};
+
+static const BIBTypeInfo bib_types[40] = {
+    {{.str = "artwork", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "audio", .len = 5},           {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "bookinbook", .len = 10},     {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "inbook", .len = 6}},
+    {{.str = "collection", .len = 10},     {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "book", .len = 4}},
+    {{.str = "conference", .len = 10},     {.str = "inproceedings", .len = 13}, {.str = "", .len = 0},            {.str = "", .len = 0}},
+    {{.str = "customa", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "customb", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "customc", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "customd", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "custome", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "customf", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "dataset", .len = 7},         {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "electronic", .len = 10},     {.str = "online", .len = 6},         {.str = "", .len = 0},            {.str = "", .len = 0}},
+    {{.str = "image", .len = 5},           {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "inreference", .len = 11},    {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "incollection", .len = 12}},
+    {{.str = "letter", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "mastersthesis", .len = 13},  {.str = "thesis", .len = 6},         {.str = "mathesis", .len = 8},    {.str = "", .len = 0}},
+    {{.str = "movie", .len = 5},           {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "music", .len = 5},           {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "mvbook", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "book", .len = 4}},
+    {{.str = "mvcollection", .len = 12},   {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "book", .len = 4}},
+    {{.str = "mvproceedings", .len = 13},  {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "proceedings", .len = 11}},
+    {{.str = "mvreference", .len = 11},    {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "book", .len = 4}},
+    {{.str = "online", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "patent", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "performance", .len = 11},    {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "periodical", .len = 10},     {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "phdthesis", .len = 9},       {.str = "thesis", .len = 6},         {.str = "phdthesis", .len = 9},   {.str = "", .len = 0}},
+    {{.str = "reference", .len = 9},       {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "book", .len = 4}},
+    {{.str = "report", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "techreport", .len = 10}},
+    {{.str = "review", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "software", .len = 8},        {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "standard", .len = 8},        {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "suppbook", .len = 8},        {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "inbook", .len = 6}},
+    {{.str = "suppcollection", .len = 14}, {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "incollection", .len = 12}},
+    {{.str = "suppperiodical", .len = 14}, {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "article", .len = 7}},
+    {{.str = "techreport", .len = 10},     {.str = "report", .len = 6},         {.str = "techreport", .len = 10}, {.str = "", .len = 0}},
+    {{.str = "thesis", .len = 6},          {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "phdthesis", .len = 9}},
+    {{.str = "video", .len = 5},           {.str = "", .len = 0},               {.str = "", .len = 0},            {.str = "misc", .len = 4}},
+    {{.str = "www", .len = 3},             {.str = "online", .len = 6},         {.str = "", .len = 0},            {.str = "", .len = 0}},
+};
+
+static const guint16 field_seeds[32] = {
+    1, 1, 3, 2, 1, 3, 1, 4, 7, 9, 2, 8,
+    1, 6, 3, 1, 1, 1, 9, 1, 9, 14, 3, 1,
+    1, 5, 4, 1, 5, 3, 17, 7,
+};
+
+static const gint16 field_slots[128] = {
+    25, 40, 56, 71, 13, 49, -1, 54, -1, 84, 24, 4,
+    35, 30, -1, 47, -1, 8, -1, -1, 15, -1, -1, -1,
+    27, -1, 0, 44, 34, -1, -1, 72, 32, 70, 26, 46,
+    73, -1, -1, -1, 68, 66, 76, 80, 37, 53, 50, -1,
+    75, -1, -1, 52, -1, 57, 61, -1, 58, 10, -1, 65,
+    -1, 18, -1, -1, 69, 14, 1, 9, -1, -1, 17, 83,
+    5, 6, 74, 23, 48, 36, 63, 62, 55, -1, 31, 43,
+    19, 11, 82, -1, -1, 12, 28, 16, 22, -1, -1, 38,
+    -1, -1, -1, 33, 2, -1, 60, 64, -1, 59, -1, -1,
+    -1, 78, -1, 51, -1, 42, 67, 45, 79, -1, 7, 41,
+    81, 29, 21, 77, 39, -1, 3, 20,
+};
+
+static const guint16 type_seeds[16] = {
+    5, 2, 2, 1, 2, 2, 0, 5, 2, 1, 3, 4,
+    10, 4, 2, 1,
+};
+
+static const gint16 type_slots[64] = {
+    2, 5, 12, 9, 11, -1, 32, 26, 7, 37, 24, -1,
+    -1, -1, 39, 29, -1, 20, 19, 28, 0, -1, 10, 14,
+    27, 33, 18, -1, 34, 23, 1, 30, 17, 15, 6, -1,
+    35, -1, 36, 3, -1, -1, -1, 13, -1, -1, -1, -1,
+    8, -1, 38, 21, 22, 31, -1, -1, -1, -1, 4, 25,
+    -1, -1, -1, 16,
+};
+
+static guint32 mapping_hash(guint32 seed, const gchar *name, gsize length) {
+  guint32 hash = 2166136261u ^ seed;
+
+  for (gsize i = 0; i < length; i++) {
+    hash = (hash ^ (guchar)name[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+gint bib_field_lookup(const BIBString *name) {
+  guint32 seed = field_seeds[mapping_hash(0, name->str, name->len) % G_N_ELEMENTS(field_seeds)];
+  gint index = field_slots[mapping_hash(seed, name->str, name->len) % G_N_ELEMENTS(field_slots)];
+
+  if (index < 0 || !bib_string_equal(&bib_fields[index].name, name)) {
+    return -1;
+  }
+
+  return index;
+}
+
+const BIBTypeInfo *bib_type_lookup(const BIBString *name) {
+  guint32 seed = type_seeds[mapping_hash(0, name->str, name->len) % G_N_ELEMENTS(type_seeds)];
+  gint index = type_slots[mapping_hash(seed, name->str, name->len) % G_N_ELEMENTS(type_slots)];
+
+  if (index < 0 || !bib_string_equal(&bib_types[index].name, name)) {
+    return NULL;
+  }
+
+  return &bib_types[index];
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Generated by tools/gen-mappings.py, do not edit.
+
+#pragma once
+
+#define BIB_MAPPINGS_HASH "70a5bb56ef3a88cd"
+
+enum BIBFieldId {
+  BIB_FIELD_ABSTRACT,
+  BIB_FIELD_ADDENDUM,
+  BIB_FIELD_ADDRESS,
+  BIB_FIELD_AFTERWORD,
+  BIB_FIELD_ANNOTATION,
+  BIB_FIELD_ANNOTATOR,
+  BIB_FIELD_ANNOTE,
+  BIB_FIELD_ARCHIVEPREFIX,
+  BIB_FIELD_AUTHOR,
+  BIB_FIELD_BOOKAUTHOR,
+  BIB_FIELD_BOOKSUBTITLE,
+  BIB_FIELD_BOOKTITLE,
+  BIB_FIELD_CHAPTER,
+  BIB_FIELD_COMMENTATOR,
+  BIB_FIELD_CROSSREF,
+  BIB_FIELD_DATE,
+  BIB_FIELD_DOI,
+  BIB_FIELD_EDITION,
+  BIB_FIELD_EDITOR,
+  BIB_FIELD_EDITORA,
+  BIB_FIELD_EDITORB,
+  BIB_FIELD_EDITORC,
+  BIB_FIELD_EID,
+  BIB_FIELD_EPRINT,
+  BIB_FIELD_EPRINTCLASS,
+  BIB_FIELD_EPRINTTYPE,
+  BIB_FIELD_EPRINTYPE,
+  BIB_FIELD_EVENTDATE,
+  BIB_FIELD_EVENTTITLE,
+  BIB_FIELD_FILE,
+  BIB_FIELD_FOREWORD,
+  BIB_FIELD_HOLDER,
+  BIB_FIELD_HOWPUBLISHED,
+  BIB_FIELD_INDEXTITLE,
+  BIB_FIELD_INSTITUTION,
+  BIB_FIELD_INTRODUCTION,
+  BIB_FIELD_ISAN,
+  BIB_FIELD_ISBN,
+  BIB_FIELD_ISMN,
+  BIB_FIELD_ISRN,
+  BIB_FIELD_ISSN,
+  BIB_FIELD_ISSUE,
+  BIB_FIELD_ISSUETITLE,
+  BIB_FIELD_JOURNAL,
+  BIB_FIELD_JOURNALSUBTITLE,
+  BIB_FIELD_JOURNALTITLE,
+  BIB_FIELD_KEY,
+  BIB_FIELD_KEYWORDS,
+  BIB_FIELD_LABEL,
+  BIB_FIELD_LANGID,
+  BIB_FIELD_LANGUAGE,
+  BIB_FIELD_LIBRARY,
+  BIB_FIELD_LOCATION,
+  BIB_FIELD_MAINSUBTITLE,
+  BIB_FIELD_MAINTITLE,
+  BIB_FIELD_MONTH,
+  BIB_FIELD_NOTE,
+  BIB_FIELD_NUMBER,
+  BIB_FIELD_ORGANIZATION,
+  BIB_FIELD_ORIGDATE,
+  BIB_FIELD_ORIGLANGUAGE,
+  BIB_FIELD_ORIGLOCATION,
+  BIB_FIELD_ORIGPUBLISHER,
+  BIB_FIELD_PAGES,
+  BIB_FIELD_PAGETOTAL,
+  BIB_FIELD_PDF,
+  BIB_FIELD_PRIMARYCLASS,
+  BIB_FIELD_PUBLISHER,
+  BIB_FIELD_PUBSTATE,
+  BIB_FIELD_SCHOOL,
+  BIB_FIELD_SERIES,
+  BIB_FIELD_SHORTHAND,
+  BIB_FIELD_SORTKEY,
+  BIB_FIELD_SUBTITLE,
+  BIB_FIELD_TITLE,
+  BIB_FIELD_TITLEADDON,
+  BIB_FIELD_TRANSLATOR,
+  BIB_FIELD_TYPE,
+  BIB_FIELD_URL,
+  BIB_FIELD_URLDATE,
+  BIB_FIELD_VENUE,
+  BIB_FIELD_VERSION,
+  BIB_FIELD_VOLUME,
+  BIB_FIELD_VOLUMES,
+  BIB_FIELD_YEAR,
+  BIB_FIELD_KNOWN
+};
+
+enum BIBFieldFlags {
+  BIB_FIELD_SKIP = 1 << 0,
+  BIB_FIELD_SKIP_WITH_DOI = 1 << 1,
+};
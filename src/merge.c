@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+// Combines several parsed files into one list. Entries are visited in input
+// order (files in the order given, entries in the stable key order bib_parse
+// leaves them in) and looked up in one hash index per criterion, so each entry
+// costs a constant number of lookups however many there are. An entry that
+// matches an earlier one by any criterion conflicts with it, and the policy
+// decides which survives.
+
+struct merge_file {
+  GBytes *contents;
+  guint jobs;
+  BIBEntryList *entries;
+  GError *error;
+};
+
+struct merge_index {
+  GPtrArray *entries;
+  GHashTable *keys;
+  GHashTable *dois;
+  GHashTable *titles;
+};
+
+static void merge_parse_file(gpointer data, gpointer user_data) {
+  struct merge_file *file = data;
+  file->entries = bib_parse(file->contents, file->jobs, &file->error);
+}
+
+// DOIs are case-insensitive and often written as URLs.
+static gchar *merge_doi(BIBEntry *entry) {
+  const BIBString *value = bib_entry_get(entry, BIB_FIELD_DOI);
+
+  if (value == NULL) {
+    return NULL;
+  }
+
+  g_auto(BIBString) doi = bib_string_resolve(value);
+  g_autofree gchar *lower = g_ascii_strdown(doi.str, doi.len);
+  gchar *start = g_strstrip(lower);
+
+  static const gchar *prefixes[] = {"https://doi.org/", "http://doi.org/", "https://dx.doi.org/", "http://dx.doi.org/", "doi:"};
+  for (gsize i = 0; i < G_N_ELEMENTS(prefixes); i++) {
+    if (g_str_has_prefix(start, prefixes[i])) {
+      start += strlen(prefixes[i]);
+      break;
+    }
+  }
+
+  return *start != '\0' ? g_strdup(start) : NULL;
+}
+
+// Titles match when their letters and digits do, ignoring case, accents,
+// braces, punctuation and spacing.
+static gchar *merge_title(BIBEntry *entry) {
+  const BIBString *value = bib_entry_get(entry, BIB_FIELD_TITLE);
+
+  if (value == NULL) {
+    return NULL;
+  }
+
+  g_auto(BIBString) title = bib_string_resolve(value);
+  g_autofree gchar *folded = g_utf8_casefold(title.str, title.len);
+  g_autofree gchar *decomposed = g_utf8_normalize(folded, -1, G_NORMALIZE_ALL);
+
+  if (decomposed == NULL) {
+    return NULL;
+  }
+
+  GString *out = g_string_sized_new(strlen(decomposed));
+
+  for (const gchar *p = decomposed; *p != '\0'; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    if (g_unichar_isalnum(c)) {
+      g_string_append_unichar(out, c);
+    }
+  }
+
+  if (out->len == 0) {
+    g_string_free(out, TRUE);
+    return NULL;
+  }
+
+  return g_string_free(out, FALSE);
+}
+
+static const gchar *merge_conflict_verb(BIBMergePolicy policy) {
+  switch (policy) {
+  case BIB_MERGE_LAST:
+    return "Replacing";
+  case BIB_MERGE_FIELDS:
+    return "Merging";
+  default:
+    return "Skipping";
+  }
+}
+
+// Points every criterion of `entry` at `slot`, leaving alone the values that
+// already belong to another slot.
+static void merge_index_add(struct merge_index *index, BIBEntry *entry, gchar *doi, gchar *title, guint slot) {
+  if (!g_hash_table_contains(index->keys, &entry->key)) {
+    g_hash_table_insert(index->keys, &entry->key, GUINT_TO_POINTER(slot));
+  }
+
+  if (doi != NULL && !g_hash_table_contains(index->dois, doi)) {
+    g_hash_table_insert(index->dois, doi, GUINT_TO_POINTER(slot));
+  } else {
+    g_free(doi);
+  }
+
+  if (title != NULL && !g_hash_table_contains(index->titles, title)) {
+    g_hash_table_insert(index->titles, title, GUINT_TO_POINTER(slot));
+  } else {
+    g_free(title);
+  }
+}
+
+static gboolean merge_lookup(GHashTable *table, gconstpointer key, guint *slot) {
+  gpointer value = NULL;
+
+  if (key == NULL || !g_hash_table_lookup_extended(table, key, NULL, &value)) {
+    return FALSE;
+  }
+
+  *slot = GPOINTER_TO_UINT(value);
+  return TRUE;
+}
+
+static gboolean merge_entry(struct merge_index *index, BIBEntry *entry, guint match, BIBMergePolicy policy, GError **error) {
+  gchar *doi = match & BIB_MATCH_DOI ? merge_doi(entry) : NULL;
+  gchar *title = match & BIB_MATCH_TITLE ? merge_title(entry) : NULL;
+  const gchar *reason = NULL;
+  guint slot = 0;
+
+  if (merge_lookup(index->keys, &entry->key, &slot)) {
+    reason = "key";
+  } else if (merge_lookup(index->dois, doi, &slot)) {
+    reason = "DOI";
+  } else if (merge_lookup(index->titles, title, &slot)) {
+    reason = "title";
+  }
+
+  if (reason == NULL) {
+    g_ptr_array_add(index->entries, entry);
+    merge_index_add(index, entry, doi, title, index->entries->len - 1);
+    return TRUE;
+  }
+
+  BIBEntry *winner = g_ptr_array_index(index->entries, slot);
+
+  if (policy == BIB_MERGE_ERROR) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Entries %.*s and %.*s have the same %s", bib_string_args(&winner->key), bib_string_args(&entry->key), reason);
+    g_free(doi);
+    g_free(title);
+    return FALSE;
+  }
+
+  if (bib_string_equal(&winner->key, &entry->key)) {
+    g_printerr("%s duplicate key %.*s\n", merge_conflict_verb(policy), bib_string_args(&entry->key));
+  } else {
+    g_printerr("%s duplicate %.*s of %.*s (same %s)\n", merge_conflict_verb(policy), bib_string_args(&entry->key), bib_string_args(&winner->key), reason);
+  }
+
+  bib_stats_add(duplicates, 1);
+
+  if (policy == BIB_MERGE_LAST) {
+    g_ptr_array_index(index->entries, slot) = entry;
+  } else if (policy == BIB_MERGE_FIELDS) {
+    // The first entry keeps its values and gains the fields it lacks.
+    for (guint i = 0; i < entry->n_fields; i++) {
+      if (bib_entry_get(winner, entry->fields[i].id) == NULL) {
+        bib_entry_set(winner, entry->fields[i].id, entry->fields[i].value);
+      }
+    }
+  }
+
+  merge_index_add(index, entry, doi, title, slot);
+
+  return TRUE;
+}
+
+// The entries point into `sources`, which must outlive the returned list.
+BIBEntryList *bib_merge(GPtrArray *sources, guint match, BIBMergePolicy policy, guint jobs, GError **error) {
+  g_autofree struct merge_file *files = g_new0(struct merge_file, sources->len);
+
+  // Files are parsed side by side, and any threads left over go to each file.
+  for (guint i = 0; i < sources->len; i++) {
+    files[i].contents = g_ptr_array_index(sources, i);
+    files[i].jobs = MAX(jobs / sources->len, 1);
+  }
+
+  bib_parallel_for(files, sources->len, sizeof(*files), merge_parse_file, NULL, jobs);
+
+  BIBEntryList *merged = bib_entry_list_create();
+  struct merge_index index = {
+      .entries = merged->entries,
+      .keys = g_hash_table_new((GHashFunc)bib_string_hash, (GEqualFunc)bib_string_equal),
+      .dois = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL),
+      .titles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL),
+  };
+  GError *fn_error = NULL;
+
+  for (guint i = 0; i < sources->len; i++) {
+    struct merge_file *file = &files[i];
+
+    if (file->error != NULL) {
+      if (fn_error == NULL) {
+        fn_error = g_steal_pointer(&file->error);
+      }
+      g_clear_error(&file->error);
+      continue;
+    }
+
+    for (guint j = 0; fn_error == NULL && j < file->entries->entries->len; j++) {
+      merge_entry(&index, g_ptr_array_index(file->entries->entries, j), match, policy, &fn_error);
+    }
+
+    // The merged entries still live in the arenas of the file they came from.
+    g_ptr_array_extend_and_steal(merged->arenas, g_steal_pointer(&file->entries->arenas));
+    file->entries->arenas = g_ptr_array_new_with_free_func(bib_arena_free);
+    bib_entry_list_free(file->entries);
+  }
+
+  g_hash_table_unref(index.keys);
+  g_hash_table_unref(index.dois);
+  g_hash_table_unref(index.titles);
+
+  if (fn_error != NULL) {
+    g_propagate_error(error, fn_error);
+    bib_entry_list_free(merged);
+    return NULL;
+  }
+
+  bib_entry_list_sort(merged, jobs);
+
+  return merged;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// The reference normalization is NFKD followed by collapsing every `\s` run
+// into a single space. NFKD leaves ASCII alone, so for ASCII text only the
+// whitespace has to be looked at. The scanners below find the first byte that
+// needs attention: anything below 0x20 (controls, \t \n \v \f \r, NUL), any
+// byte of a multi-byte UTF-8 sequence, or a space followed by another space.
+// Everything before that offset is already in normal form.
+
+static GRegex *regex = NULL;
+
+void bib_free_regex(void) {
+  g_clear_pointer(&regex, g_regex_unref);
+}
+
+typedef gsize (*scan_func)(const gchar *text, gsize length);
+
+static bool is_space(guchar c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static gsize scan_scalar(const gchar *text, gsize length) {
+  for (gsize i = 0; i < length; i++) {
+    guchar c = text[i];
+    if (c < 0x20 || c >= 0x80 || (c == ' ' && i + 1 < length && text[i + 1] == ' ')) {
+      return i;
+    }
+  }
+
+  return length;
+}
+
+#if defined(__SSE2__)
+static gsize scan_sse2(const gchar *text, gsize length) {
+  const __m128i limit = _mm_set1_epi8(0x20);
+  const __m128i space = _mm_set1_epi8(' ');
+  gsize i = 0;
+
+  // Reads one byte past the block to catch a double space across blocks.
+  for (; i + 17 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+    __m128i next = _mm_loadu_si128((const __m128i *)(text + i + 1));
+    // Signed compare: bytes >= 0x80 are negative, so they are caught too.
+    __m128i special = _mm_cmplt_epi8(block, limit);
+    __m128i doubled = _mm_and_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(next, space));
+    guint mask = _mm_movemask_epi8(_mm_or_si128(special, doubled));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + scan_scalar(text + i, length - i);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) static gsize scan_avx2(const gchar *text, gsize length) {
+  const __m256i limit = _mm256_set1_epi8(0x20);
+  const __m256i space = _mm256_set1_epi8(' ');
+  gsize i = 0;
+
+  for (; i + 33 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(text + i));
+    __m256i next = _mm256_loadu_si256((const __m256i *)(text + i + 1));
+    __m256i special = _mm256_cmpgt_epi8(limit, block);
+    __m256i doubled = _mm256_and_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(next, space));
+    guint mask = _mm256_movemask_epi8(_mm256_or_si256(special, doubled));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + scan_scalar(text + i, length - i);
+}
+#endif
+
+static scan_func scan_select(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return scan_avx2;
+  }
+#endif
+#if defined(__SSE2__)
+  return scan_sse2;
+#else
+  return scan_scalar;
+#endif
+}
+
+static gsize scan(const gchar *text, gsize length) {
+  static gsize func = 0;
+
+  if (g_once_init_enter(&func)) {
+    g_once_init_leave(&func, (gsize)scan_select());
+  }
+
+  return ((scan_func)func)(text, length);
+}
+
+static BIBString normalize_unicode(const gchar *text, gsize length) {
+  if (g_once_init_enter(&regex)) {
+    g_once_init_leave(&regex, g_regex_new("[\\s\\n]+", G_REGEX_OPTIMIZE | G_REGEX_NEWLINE_ANYCRLF, G_REGEX_MATCH_DEFAULT, NULL));
+  }
+
+  g_autofree gchar *normalized = g_utf8_normalize(text, length, G_NORMALIZE_ALL);
+  if (normalized == NULL) {
+    return bib_string_literal("");
+  }
+
+  gchar *replaced = g_regex_replace_literal(regex, normalized, -1, 0, " ", G_REGEX_MATCH_DEFAULT, NULL);
+  return bib_string_take(replaced);
+}
+
+BIBString bib_normalize(const gchar *text, gsize length) {
+  gsize i = scan(text, length);
+
+  if (i == length) {
+    return bib_string_view(text, length);
+  }
+
+  bib_stats_add(normalized, 1);
+
+  GString *out = g_string_sized_new(length);
+  gsize pos = 0;
+
+  while (true) {
+    g_string_append_len(out, text + pos, i - pos);
+
+    if (i == length) {
+      break;
+    }
+
+    guchar c = text[i];
+
+    if (c >= 0x80) {
+      // NFKD may compose with, or turn into, neighbouring characters, so the
+      // whole text goes through GLib instead of just this span.
+      g_string_free(out, TRUE);
+      return normalize_unicode(text, length);
+    } else if (c == '\0') {
+      // g_utf8_normalize stops at the first NUL.
+      break;
+    } else if (is_space(c)) {
+      gsize j = i + 1;
+      while (j < length && is_space(text[j])) {
+        j++;
+      }
+      if (i == 0 || text[i - 1] != ' ') {
+        g_string_append_c(out, ' ');
+      }
+      pos = j;
+    } else {
+      g_string_append_c(out, c);
+      pos = i + 1;
+    }
+
+    i = pos + scan(text + pos, length - pos);
+  }
+
+  return bib_string_take(g_string_free(out, FALSE));
+}
@@ -17,24 +17,30 @@
 #include "internal.h"
 
 #include <string.h>
-#include <tree_sitter/api.h>
-
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(TSParser, ts_parser_delete)
-G_DEFINE_AUTOPTR_CLEANUP_FUNC(TSTree, ts_tree_delete)
 
 extern const TSLanguage *tree_sitter_biber(void);
 
-static GRegex *regex = NULL;
+static GPrivate parser_key = G_PRIVATE_INIT((GDestroyNotify)ts_parser_delete);
+
+// Parsers are expensive to set up and cannot be shared between threads, so
+// each thread keeps one around for every file it parses.
+TSParser *bib_parser(void) {
+  TSParser *parser = g_private_get(&parser_key);
 
-void free_regex(void) {
-  g_regex_unref(regex);
+  if (parser == NULL) {
+    parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_biber());
+    g_private_set(&parser_key, parser);
+  }
+
+  return parser;
 }
 
-gchar *remove_symbols(const gchar *str) {
-  gchar *an = g_malloc0_n(strlen(str), sizeof(char));
+static gchar *remove_symbols(const BIBString *str) {
+  gchar *an = g_malloc0_n(str->len + 1, sizeof(char));
   gsize j = 0;
-  for (gsize i = 0; i < strlen(str); i++) {
-    gchar c = str[i];
+  for (gsize i = 0; i < str->len; i++) {
+    gchar c = str->str[i];
     if (g_ascii_isalnum(c)) {
       an[j++] = c;
     }
@@ -42,7 +48,7 @@ gchar *remove_symbols(const gchar *str) {
   return an;
 }
 
-guint64 parse_year(const gchar *year) {
+static guint64 parse_year(const BIBString *year) {
   g_autofree gchar *y = remove_symbols(year);
   guint64 num = g_ascii_strtoull(y, NULL, 10);
   return num;
@@ -54,7 +60,7 @@ guint64 parse_year(const gchar *year) {
   case hash_month_expr(A, B, C):    \
     return D
 
-guint64 parse_month(const gchar *month) {
+static guint64 parse_month(const BIBString *month) {
   g_autofree gchar *m = remove_symbols(month);
 
   if (g_ascii_isdigit(m[0])) {
@@ -88,82 +94,140 @@ guint64 parse_month(const gchar *month) {
   }
 }
 
-gchar *ts_node_text(TSNode node, const GString *contents) {
+static BIBString ts_node_text(TSNode node, const gchar *source) {
   uint32_t start = ts_node_start_byte(node);
   uint32_t end = ts_node_end_byte(node);
   size_t length = end - start;
 
   if (length == 0) {
-    return NULL;
+    return bib_string_literal("");
   }
 
-  if (regex == NULL) {
-    regex = g_regex_new("[\\s\\n]+", G_REGEX_OPTIMIZE | G_REGEX_NEWLINE_ANYCRLF, G_REGEX_MATCH_DEFAULT, NULL);
+  return bib_normalize(source + start, length);
+}
+
+static bool cursor_goto_next_named_sibling(TSTreeCursor *cursor) {
+  while (ts_tree_cursor_goto_next_sibling(cursor)) {
+    if (ts_node_is_named(ts_tree_cursor_current_node(cursor))) {
+      return true;
+    }
   }
 
-  g_autofree gchar *normalized = g_utf8_normalize(contents->str + start, length, G_NORMALIZE_ALL);
-  gchar *replaced = g_regex_replace_literal(regex, normalized, -1, 0, " ", G_REGEX_MATCH_DEFAULT, NULL);
-  return replaced;
+  return false;
 }
 
-gchar *bib_parse_entry_to_biblatex_property_name(gchar *name) {
-  if (g_strcmp0(name, "address") == 0) {
-    return g_strdup("location");
-  } else if (g_strcmp0(name, "journal") == 0) {
-    return g_strdup("journaltitle");
+static bool cursor_goto_first_named_child(TSTreeCursor *cursor) {
+  if (!ts_tree_cursor_goto_first_child(cursor)) {
+    return false;
   }
 
-  return g_strdup(name);
+  if (ts_node_is_named(ts_tree_cursor_current_node(cursor)) || cursor_goto_next_named_sibling(cursor)) {
+    return true;
+  }
+
+  ts_tree_cursor_goto_parent(cursor);
+  return false;
+}
+
+// Walks the cursor over the named children of the current node, leaving it
+// back on that node once the last child has been visited.
+#define cursor_foreach_named_child(CURSOR)                                     \
+  for (bool _has_child = cursor_goto_first_named_child(CURSOR); _has_child;    \
+       _has_child = cursor_goto_next_named_sibling(CURSOR) ||                  \
+                    !ts_tree_cursor_goto_parent(CURSOR))
+
+static void cursor_field_nodes(TSTreeCursor *cursor, TSNode *key, TSNode *value) {
+  gsize i = 0;
+  cursor_foreach_named_child(cursor) {
+    if (i == 0) {
+      *key = ts_tree_cursor_current_node(cursor);
+    } else if (i == 1) {
+      *value = ts_tree_cursor_current_node(cursor);
+    }
+    i++;
+  }
 }
 
-BIBEntry *bib_parse_entry(TSNode node, const GString *contents, GError **error) {
-  BIBEntry *entry = bib_entry_create();
+// The conversions below are shared by tree-sitter and the fast scanner (see
+// fastscan.c), so that both turn the same source text into the same entry.
+// `type`, `key` and `name` are normalized text, and are consumed.
+
+void bib_parse_type(BIBEntry *entry, BIBString type) {
+  bib_string_down(&type);
+  const BIBTypeInfo *info = bib_type_lookup(&type);
+  if (info != NULL && info->biblatex.len > 0) {
+    entry->type = info->biblatex;
+    if (info->subtype.len > 0) {
+      bib_entry_set(entry, BIB_FIELD_TYPE, info->subtype);
+    }
+    bib_string_clear(&type);
+  } else {
+    entry->type = bib_arena_string(entry->arena, type);
+  }
+}
+
+void bib_parse_key(BIBEntry *entry, BIBString key) {
+  bib_string_down(&key);
+  entry->key = bib_arena_string(entry->arena, key);
+}
+
+// `value` is the raw source text of the value, delimiters included. Years and
+// months are collected into `year` and `month` for bib_parse_date.
+void bib_parse_field(BIBEntry *entry, BIBString name, const gchar *value, gsize length, guint64 *year, guint64 *month) {
+  bib_string_down(&name);
+  guint id = bib_field_intern(&name);
+  bib_string_clear(&name);
+
+  if (id == BIB_FIELD_YEAR || id == BIB_FIELD_MONTH) {
+    g_auto(BIBString) text = length > 0 ? bib_normalize(value, length) : bib_string_literal("");
+    if (id == BIB_FIELD_YEAR) {
+      *year = parse_year(&text);
+    } else {
+      *month = parse_month(&text);
+    }
+  } else {
+    bib_entry_set(entry, bib_field_to_biblatex(id), bib_string_pending(value, length));
+  }
+}
+
+void bib_parse_date(BIBEntry *entry, guint64 year, guint64 month) {
+  if (year == 0) {
+    return;
+  }
+
+  const gsize size = 48;
+  gchar *date = bib_arena_alloc(entry->arena, size);
+  gint length = 0;
+  if (month > 0) {
+    length = g_snprintf(date, size, "{%lu-%lu}", year, month);
+  } else {
+    length = g_snprintf(date, size, "{%lu}", year);
+  }
+  bib_entry_set(entry, BIB_FIELD_DATE, bib_string_view(date, length));
+}
+
+BIBEntry *bib_parse_entry(TSTreeCursor *cursor, const gchar *source, BIBArena *arena, GError **error) {
+  BIBEntry *entry = bib_entry_create(arena);
   guint64 year = 0;
   guint64 month = 0;
 
-  for (gsize i = 0; i < ts_node_named_child_count(node); i++) {
-    TSNode child = ts_node_named_child(node, i);
+  cursor_foreach_named_child(cursor) {
+    TSNode child = ts_tree_cursor_current_node(cursor);
     const char *type = ts_node_type(child);
 
     switch (type[0]) {
-      case 'n': { // name
-        g_autofree gchar *type = ts_node_text(child, contents);
-        if (g_ascii_strcasecmp(type, "phdthesis") == 0) {
-          entry->type = g_strdup("thesis");
-          g_hash_table_insert(entry->properties, g_strdup("type"), g_strdup("phdthesis"));
-        } else if (g_ascii_strcasecmp(type, "mastersthesis") == 0) {
-          entry->type = g_strdup("thesis");
-          g_hash_table_insert(entry->properties, g_strdup("type"), g_strdup("mathesis"));
-        } else {
-          entry->type = g_utf8_strdown(type, -1);
-        }
+      case 'n': // name
+        bib_parse_type(entry, ts_node_text(child, source));
         continue;
-      }
-      case 'k': { // key
-        g_autofree gchar *key = ts_node_text(child, contents);
-        entry->key = g_utf8_strdown(key, -1);
+      case 'k': // key
+        bib_parse_key(entry, ts_node_text(child, source));
         continue;
-      }
       case 'f': { // field
-        TSNode key = ts_node_named_child(child, 0);
-        TSNode value = ts_node_named_child(child, 1);
-        g_autofree gchar *key_text_raw = ts_node_text(key, contents);
-        gchar *key_text = g_utf8_strdown(key_text_raw, -1);
-        gchar *value_text = ts_node_text(value, contents);
-        if (g_ascii_strcasecmp(key_text, "year") == 0) {
-          year = parse_year(value_text);
-          g_free(key_text);
-          g_free(value_text);
-          continue;
-        } else if (g_ascii_strcasecmp(key_text, "month") == 0) {
-          month = parse_month(value_text);
-          g_free(key_text);
-          g_free(value_text);
-          continue;
-        } else {
-          gchar *biblatex_name = bib_parse_entry_to_biblatex_property_name(key_text);
-          g_hash_table_insert(entry->properties, biblatex_name, value_text);
-        }
+        TSNode key = {0};
+        TSNode value = {0};
+        cursor_field_nodes(cursor, &key, &value);
+        uint32_t start = ts_node_start_byte(value);
+        bib_parse_field(entry, ts_node_text(key, source), source + start, ts_node_end_byte(value) - start, &year, &month);
         continue;
       }
       default:
@@ -171,53 +235,354 @@ BIBEntry *bib_parse_entry(TSNode node, const GString *contents, GError **error)
     }
   }
 
-  if (year > 0) {
-    if (month > 0) {
-      gchar *date = g_strdup_printf("{%lu-%lu}", year, month);
-      g_hash_table_insert(entry->properties, g_strdup("date"), date);
+  bib_parse_date(entry, year, month);
+
+  return entry;
+}
+
+struct parse_batch {
+  const TSTree *tree;
+  const gchar *source;
+  uint32_t start_byte;
+  gsize first;
+  gsize count;
+  BIBEntryList *entries;
+  BIBArena *arena;
+  GError *error;
+};
+
+// Converts a run of consecutive entries, starting at the one that begins at
+// `start_byte`. Each batch walks its own copy of the tree, as tree-sitter
+// trees cannot be shared across threads.
+static void bib_parse_batch(gpointer data, gpointer user_data) {
+  struct parse_batch *batch = data;
+  g_autoptr(TSTree) tree = ts_tree_copy(batch->tree);
+  g_auto(TSTreeCursor) cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  gsize i = 0;
+  gsize fields = 0;
+
+  if (ts_tree_cursor_goto_first_child_for_byte(&cursor, batch->start_byte) < 0) {
+    return;
+  }
+
+  do {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (!ts_node_is_named(node) || g_strcmp0(ts_node_type(node), "entry") != 0) {
+      continue;
+    }
+
+    BIBEntry *entry = bib_parse_entry(&cursor, batch->source, batch->arena, &batch->error);
+
+    if (batch->error != NULL) {
+      return;
+    }
+
+    g_ptr_array_index(batch->entries->entries, batch->first + i) = entry;
+    fields += entry->n_fields;
+    i++;
+  } while (i < batch->count && ts_tree_cursor_goto_next_sibling(&cursor));
+
+  bib_stats_add(entries, i);
+  bib_stats_add(fields, fields);
+}
+
+// Parses only the given byte ranges of the source when `ranges` is not NULL.
+// Unless `sort` is set, the entries are left in the order of the source, and
+// `entry_starts`, if given, gets where each of them starts.
+static BIBEntryList *bib_parse_ranges(GBytes *bibfile, const TSRange *ranges, guint n_ranges, gboolean sort, GArray **entry_starts, guint jobs, GError **error) {
+  g_autoptr(TSTree) tree = NULL;
+  gsize length = 0;
+  const gchar *source = g_bytes_get_data(bibfile, &length);
+
+  if (length == 0 || (ranges != NULL && n_ranges == 0)) {
+    if (entry_starts != NULL) {
+      *entry_starts = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    }
+    return bib_entry_list_create();
+  }
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+
+  TSParser *parser = bib_parser();
+
+  if (ranges != NULL) {
+    ts_parser_set_included_ranges(parser, ranges, n_ranges);
+  }
+
+  tree = ts_parser_parse_string(parser, NULL, source, length);
+
+  if (ranges != NULL) {
+    ts_parser_set_included_ranges(parser, NULL, 0);
+  }
+
+  g_auto(TSTreeCursor) cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  g_autoptr(GArray) starts = g_array_new(FALSE, FALSE, sizeof(uint32_t));
+
+  cursor_foreach_named_child(&cursor) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (g_strcmp0(ts_node_type(node), "entry") == 0) {
+      uint32_t start = ts_node_start_byte(node);
+      g_array_append_val(starts, start);
+    }
+  }
+
+  bib_stats_stop(&timer, BIB_PHASE_PARSE);
+  bib_stats_start(&timer);
+
+  BIBEntryList *entries = bib_entry_list_create();
+  g_ptr_array_set_size(entries->entries, starts->len);
+
+  // A few batches per thread keeps the workers busy when entry sizes vary.
+  gsize batch_size = MAX(starts->len / (jobs * 4), 1);
+  gsize n_batches = (starts->len + batch_size - 1) / batch_size;
+  g_autofree struct parse_batch *batches = g_new0(struct parse_batch, n_batches);
+
+  for (gsize i = 0; i < n_batches; i++) {
+    batches[i].tree = tree;
+    batches[i].source = source;
+    batches[i].first = i * batch_size;
+    batches[i].count = MIN(batch_size, starts->len - batches[i].first);
+    batches[i].start_byte = g_array_index(starts, uint32_t, batches[i].first);
+    batches[i].entries = entries;
+    // Each batch allocates from its own arena, so workers never contend.
+    batches[i].arena = bib_arena_new();
+    bib_entry_list_add_arena(entries, batches[i].arena);
+  }
+
+  bib_parallel_for(batches, n_batches, sizeof(*batches), bib_parse_batch, NULL, jobs);
+  bib_stats_stop(&timer, BIB_PHASE_CONVERT);
+
+  GError *fn_error = NULL;
+  for (gsize i = 0; i < n_batches; i++) {
+    if (batches[i].error != NULL && fn_error == NULL) {
+      fn_error = batches[i].error;
+    } else if (batches[i].error != NULL) {
+      g_error_free(batches[i].error);
+    }
+  }
+
+  if (fn_error != NULL) {
+    bib_entry_list_free(entries);
+    g_propagate_error(error, fn_error);
+    return NULL;
+  }
+
+  if (sort) {
+    bib_entry_list_sort(entries, jobs);
+  }
+
+  if (entry_starts != NULL) {
+    *entry_starts = g_steal_pointer(&starts);
+  }
+
+  return entries;
+}
+
+TSPoint bib_advance_point(const gchar *source, gsize *position, TSPoint point, gsize target) {
+  while (*position < target) {
+    const gchar *newline = memchr(source + *position, '\n', target - *position);
+
+    if (newline == NULL) {
+      point.column += target - *position;
+      *position = target;
     } else {
-      gchar *date = g_strdup_printf("{%lu}", year);
-      g_hash_table_insert(entry->properties, g_strdup("date"), date);
+      point.row++;
+      point.column = 0;
+      *position = newline - source + 1;
     }
   }
 
-  return entry;
+  return point;
 }
 
-static gint sort_entries(gconstpointer a, gconstpointer b) {
-  const BIBEntry *entry1 = *((BIBEntry **)a);
-  const BIBEntry *entry2 = *((BIBEntry **)b);
-  return g_ascii_strcasecmp(entry1->key, entry2->key);
+static gboolean fast_scan = TRUE;
+
+// Whether bib_parse tries the fast scanner (see fastscan.c) before
+// tree-sitter. Set before any parsing starts.
+void bib_parse_set_fast_scan(gboolean enable) {
+  fast_scan = enable;
 }
 
-BIBEntryList *bib_parse(const GString *bibfile, GError **error) {
-  g_autoptr(TSParser) parser = NULL;
-  g_autoptr(TSTree) tree = NULL;
-  g_autoptr(GError) fn_error = NULL;
+struct fast_batch {
+  const gchar *source;
+  const BIBSpan *spans;
+  BIBEntry **entries;
+  gsize count;
+  BIBArena *arena;
+};
+
+static void bib_parse_fast_batch(gpointer data, gpointer user_data) {
+  struct fast_batch *batch = data;
+  gsize converted = 0;
+  gsize fields = 0;
+
+  for (gsize i = 0; i < batch->count; i++) {
+    BIBEntry *entry = bib_fast_parse_entry(batch->source, &batch->spans[i], batch->arena);
+    batch->entries[i] = entry;
+
+    if (entry != NULL) {
+      converted++;
+      fields += entry->n_fields;
+    }
+  }
+
+  bib_stats_add(entries, converted);
+  bib_stats_add(fields, fields);
+}
+
+// Converts the entries the fast scanner is sure about, and has tree-sitter
+// parse only those it declines, limited to their ranges as for
+// bib_parse_cited. Their entries are then put back in place, so the list is in
+// the order of the source, as tree-sitter alone would have left it.
+static BIBEntryList *bib_parse_fast(GBytes *bibfile, gboolean sort, guint jobs, GError **error) {
+  gsize length = 0;
+  const gchar *source = g_bytes_get_data(bibfile, &length);
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+  g_autoptr(GArray) spans = bib_fast_split(source, length);
+  bib_stats_stop(&timer, BIB_PHASE_PARSE);
+
+  if (spans == NULL) {
+    return bib_parse_ranges(bibfile, NULL, 0, sort, NULL, jobs, error);
+  }
 
-  parser = ts_parser_new();
-  ts_parser_set_language(parser, tree_sitter_biber());
-  tree = ts_parser_parse_string(parser, NULL, bibfile->str, bibfile->len);
+  bib_stats_start(&timer);
 
-  TSNode root_node = ts_tree_root_node(tree);
   BIBEntryList *entries = bib_entry_list_create();
+  g_autofree BIBEntry **converted = g_new0(BIBEntry *, spans->len);
+
+  gsize batch_size = MAX(spans->len / (jobs * 4), 1);
+  gsize n_batches = (spans->len + batch_size - 1) / batch_size;
+  g_autofree struct fast_batch *batches = g_new0(struct fast_batch, n_batches);
+
+  for (gsize i = 0; i < n_batches; i++) {
+    gsize first = i * batch_size;
+    batches[i].source = source;
+    batches[i].spans = &g_array_index(spans, BIBSpan, first);
+    batches[i].entries = converted + first;
+    batches[i].count = MIN(batch_size, spans->len - first);
+    batches[i].arena = bib_arena_new();
+    bib_entry_list_add_arena(entries, batches[i].arena);
+  }
 
-  for (gsize i = 0; i < ts_node_named_child_count(root_node); i++) {
-    TSNode node = ts_node_named_child(root_node, i);
-    if (g_strcmp0(ts_node_type(node), "entry") == 0) {
-      BIBEntry *entry = bib_parse_entry(node, bibfile, &fn_error);
+  bib_parallel_for(batches, n_batches, sizeof(*batches), bib_parse_fast_batch, NULL, jobs);
+  bib_stats_stop(&timer, BIB_PHASE_CONVERT);
 
-      if (fn_error != NULL) {
-        bib_entry_list_free(entries);
-        g_propagate_error(error, fn_error);
-        return NULL;
-      }
+  g_autoptr(GArray) ranges = g_array_new(FALSE, FALSE, sizeof(TSRange));
+  gsize position = 0;
+  TSPoint point = {0, 0};
+
+  for (guint i = 0; i < spans->len; i++) {
+    BIBSpan *span = &g_array_index(spans, BIBSpan, i);
+
+    if (converted[i] == NULL) {
+      TSRange range = {.start_byte = span->start, .end_byte = span->end};
+      range.start_point = point = bib_advance_point(source, &position, point, span->start);
+      range.end_point = point = bib_advance_point(source, &position, point, span->end);
+      g_array_append_val(ranges, range);
+    }
+  }
+
+  bib_stats_add(declined, ranges->len);
 
-      g_ptr_array_add(entries, entry);
+  g_autoptr(GArray) starts = NULL;
+  BIBEntryList *declined = NULL;
+
+  if (ranges->len > 0) {
+    declined = bib_parse_ranges(bibfile, (TSRange *)ranges->data, ranges->len, FALSE, &starts, jobs, error);
+
+    if (declined == NULL) {
+      bib_entry_list_free(entries);
+      return NULL;
     }
   }
 
-  g_ptr_array_sort(entries, sort_entries);
+  // Each declined span gives tree-sitter's entries that start inside it.
+  guint j = 0;
+
+  for (guint i = 0; i < spans->len; i++) {
+    BIBSpan *span = &g_array_index(spans, BIBSpan, i);
+
+    if (converted[i] != NULL) {
+      g_ptr_array_add(entries->entries, converted[i]);
+      continue;
+    }
+
+    while (declined != NULL && j < declined->entries->len && g_array_index(starts, uint32_t, j) < span->end) {
+      g_ptr_array_add(entries->entries, g_ptr_array_index(declined->entries, j++));
+    }
+  }
+
+  if (declined != NULL) {
+    g_ptr_array_extend_and_steal(entries->arenas, g_steal_pointer(&declined->arenas));
+    g_ptr_array_unref(declined->entries);
+    g_free(declined);
+  }
+
+  if (sort) {
+    bib_entry_list_sort(entries, jobs);
+  }
 
   return entries;
 }
+
+BIBEntryList *bib_parse(GBytes *bibfile, guint jobs, GError **error) {
+  if (fast_scan) {
+    return bib_parse_fast(bibfile, TRUE, jobs, error);
+  }
+
+  return bib_parse_ranges(bibfile, NULL, 0, TRUE, NULL, jobs, error);
+}
+
+BIBEntryList *bib_parse_unsorted(GBytes *bibfile, guint jobs, GError **error) {
+  if (fast_scan) {
+    return bib_parse_fast(bibfile, FALSE, jobs, error);
+  }
+
+  return bib_parse_ranges(bibfile, NULL, 0, FALSE, NULL, jobs, error);
+}
+
+// Extracts only the entries whose keys are in `keys`. A pre-scan of the entry
+// headers finds where the cited entries are, and tree-sitter is then limited
+// to those ranges, so the rest of the file is never parsed nor converted.
+BIBEntryList *bib_parse_cited(GBytes *bibfile, GHashTable *keys, guint jobs, GError **error) {
+  if (g_hash_table_contains(keys, "*")) {
+    return bib_parse(bibfile, jobs, error);
+  }
+
+  gsize length = 0;
+  const gchar *source = g_bytes_get_data(bibfile, &length);
+  g_autoptr(GArray) spans = bib_scan_entries(source, length);
+  g_autoptr(GArray) ranges = g_array_new(FALSE, FALSE, sizeof(TSRange));
+  g_autoptr(GHashTable) found = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  gsize position = 0;
+  TSPoint point = {0, 0};
+
+  for (guint i = 0; i < spans->len; i++) {
+    BIBSpan *span = &g_array_index(spans, BIBSpan, i);
+    g_autofree gchar *key = g_utf8_strdown(span->key.str, span->key.len);
+
+    if (!g_hash_table_contains(keys, key)) {
+      continue;
+    }
+
+    TSRange range = {.start_byte = span->start, .end_byte = span->end};
+    range.start_point = point = bib_advance_point(source, &position, point, span->start);
+    range.end_point = point = bib_advance_point(source, &position, point, span->end);
+    g_array_append_val(ranges, range);
+    g_hash_table_add(found, g_steal_pointer(&key));
+  }
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, keys);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    if (!g_hash_table_contains(found, key)) {
+      g_printerr("Citation key %s not found\n", (gchar *)key);
+    }
+  }
+
+  return bib_parse_ranges(bibfile, (TSRange *)ranges->data, ranges->len, TRUE, NULL, jobs, error);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+// A cheap pre-scan that only looks at entry headers, `@type{key,`, and at the
+// braces needed to find where each entry ends. It does not look inside field
+// values and allocates nothing but the resulting array.
+
+static gsize skip_space(const gchar *text, gsize length, gsize i) {
+  while (i < length && g_ascii_isspace(text[i])) {
+    i++;
+  }
+  return i;
+}
+
+// Returns the offset just past the delimiter closing the entry opened at
+// `open`, or `length` if the input ends first.
+static gsize find_entry_end(const gchar *text, gsize length, gsize open) {
+  gchar close = text[open] == '(' ? ')' : '}';
+  gsize depth = 0;
+
+  for (gsize i = open + 1; i < length; i++) {
+    gchar c = text[i];
+    if (c == '{') {
+      depth++;
+    } else if (c == '}' && depth > 0) {
+      depth--;
+    } else if (c == close && depth == 0) {
+      return i + 1;
+    }
+  }
+
+  return length;
+}
+
+static gboolean is_special_type(const gchar *type, gsize length) {
+  return (length == strlen("comment") && g_ascii_strncasecmp(type, "comment", length) == 0) ||
+         (length == strlen("string") && g_ascii_strncasecmp(type, "string", length) == 0) ||
+         (length == strlen("preamble") && g_ascii_strncasecmp(type, "preamble", length) == 0);
+}
+
+GArray *bib_scan_entries(const gchar *text, gsize length) {
+  GArray *spans = g_array_new(FALSE, FALSE, sizeof(BIBSpan));
+  gsize depth = 0;
+  gsize i = 0;
+
+  while (i < length) {
+    gchar c = text[i];
+
+    if (c == '{') {
+      depth++;
+    } else if (c == '}' && depth > 0) {
+      depth--;
+    }
+
+    if (c != '@' || depth > 0) {
+      i++;
+      continue;
+    }
+
+    gsize start = i;
+    gsize type_start = skip_space(text, length, i + 1);
+    gsize type_end = type_start;
+    while (type_end < length && (g_ascii_isalnum(text[type_end]) || text[type_end] == '_' || text[type_end] == '-')) {
+      type_end++;
+    }
+
+    gsize open = skip_space(text, length, type_end);
+    if (type_end == type_start || open >= length || (text[open] != '{' && text[open] != '(')) {
+      i = open;
+      continue;
+    }
+
+    gsize end = find_entry_end(text, length, open);
+
+    if (!is_special_type(text + type_start, type_end - type_start)) {
+      gsize key_start = skip_space(text, length, open + 1);
+      gsize key_end = key_start;
+      while (key_end < end && text[key_end] != ',' && text[key_end] != '}' && text[key_end] != ')' && !g_ascii_isspace(text[key_end])) {
+        key_end++;
+      }
+
+      BIBSpan span = {.start = start, .end = end, .key = bib_string_view(text + key_start, key_end - key_start)};
+      g_array_append_val(spans, span);
+    }
+
+    i = end;
+  }
+
+  return spans;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+// Output is formatted straight into a chain of fixed-size blocks. A sink bound
+// to a file descriptor hands its blocks to writev once enough have filled up;
+// one bound to a GOutputStream (used to compress the output) writes them to
+// it the same way; a memory sink keeps them until they are spliced into
+// another sink (this is how worker threads pass their output on) or collected
+// into bytes.
+//
+// Write errors are sticky, like stdio's: once one happens every further write
+// is dropped, and the error is reported by bib_sink_close.
+
+#define BIB_SINK_MIN_BLOCK_SIZE 1024
+#define BIB_SINK_BLOCK_SIZE (64 * 1024)
+#define BIB_SINK_FLUSH_BLOCKS 16
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct BIBSinkBlock {
+  gsize used;
+  gsize size;
+  gchar data[];
+};
+
+// Memory sinks often hold a single entry, so their blocks start small and
+// double up to the full block size.
+struct BIBSink {
+  GPtrArray *blocks;
+  gsize next_size;
+  gint fd;
+  GOutputStream *stream;
+  GError *error;
+};
+
+static BIBSink *sink_new(gint fd, GOutputStream *stream) {
+  BIBSink *sink = g_new0(BIBSink, 1);
+  sink->blocks = g_ptr_array_new_with_free_func(g_free);
+  sink->next_size = fd >= 0 || stream != NULL ? BIB_SINK_BLOCK_SIZE : BIB_SINK_MIN_BLOCK_SIZE;
+  sink->fd = fd;
+  sink->stream = stream != NULL ? g_object_ref(stream) : NULL;
+  return sink;
+}
+
+static gboolean sink_is_memory(BIBSink *sink) {
+  return sink->fd < 0 && sink->stream == NULL;
+}
+
+BIBSink *bib_sink_new(void) {
+  return sink_new(-1, NULL);
+}
+
+// The descriptor is not closed by the sink.
+BIBSink *bib_sink_new_fd(gint fd) {
+  return sink_new(fd, NULL);
+}
+
+// The stream is closed by bib_sink_close, which lets a converter write out
+// whatever it still holds.
+BIBSink *bib_sink_new_stream(GOutputStream *stream) {
+  return sink_new(-1, stream);
+}
+
+static struct BIBSinkBlock *sink_block(BIBSink *sink) {
+  struct BIBSinkBlock *block = NULL;
+
+  if (sink->blocks->len > 0) {
+    block = g_ptr_array_index(sink->blocks, sink->blocks->len - 1);
+  }
+
+  if (block == NULL || block->used == block->size) {
+    if (!sink_is_memory(sink) && sink->blocks->len >= BIB_SINK_FLUSH_BLOCKS) {
+      bib_sink_flush(sink);
+    }
+
+    block = g_malloc(sizeof(struct BIBSinkBlock) + sink->next_size);
+    block->used = 0;
+    block->size = sink->next_size;
+    sink->next_size = MIN(sink->next_size * 2, BIB_SINK_BLOCK_SIZE);
+    g_ptr_array_add(sink->blocks, block);
+    bib_stats_add(sink_blocks, 1);
+  }
+
+  return block;
+}
+
+void bib_sink_append(BIBSink *sink, const gchar *data, gsize length) {
+  while (length > 0 && sink->error == NULL) {
+    struct BIBSinkBlock *block = sink_block(sink);
+    gsize n = MIN(length, block->size - block->used);
+    memcpy(block->data + block->used, data, n);
+    block->used += n;
+    data += n;
+    length -= n;
+  }
+}
+
+void bib_sink_fill(BIBSink *sink, gchar c, gsize count) {
+  while (count > 0 && sink->error == NULL) {
+    struct BIBSinkBlock *block = sink_block(sink);
+    gsize n = MIN(count, block->size - block->used);
+    memset(block->data + block->used, c, n);
+    block->used += n;
+    count -= n;
+  }
+}
+
+void bib_sink_printf(BIBSink *sink, const gchar *format, ...) {
+  gchar buffer[256];
+  va_list args;
+
+  va_start(args, format);
+  gint length = g_vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  if (length < (gint)sizeof(buffer)) {
+    bib_sink_append(sink, buffer, length);
+    return;
+  }
+
+  va_start(args, format);
+  g_autofree gchar *formatted = g_strdup_vprintf(format, args);
+  va_end(args);
+
+  bib_sink_append(sink, formatted, length);
+}
+
+// Moves the blocks of `source` to the end of `sink`, without copying them.
+void bib_sink_splice(BIBSink *sink, BIBSink *source) {
+  for (guint i = 0; i < source->blocks->len; i++) {
+    g_ptr_array_add(sink->blocks, g_ptr_array_index(source->blocks, i));
+  }
+
+  g_ptr_array_set_free_func(source->blocks, NULL);
+  g_ptr_array_set_size(source->blocks, 0);
+  g_ptr_array_set_free_func(source->blocks, g_free);
+
+  if (!sink_is_memory(sink) && sink->blocks->len >= BIB_SINK_FLUSH_BLOCKS) {
+    bib_sink_flush(sink);
+  }
+}
+
+static void sink_flush_stream(BIBSink *sink) {
+  g_autofree GOutputVector *vectors = g_new(GOutputVector, sink->blocks->len);
+  gsize written = 0;
+
+  for (guint i = 0; i < sink->blocks->len; i++) {
+    struct BIBSinkBlock *block = g_ptr_array_index(sink->blocks, i);
+    vectors[i].buffer = block->data;
+    vectors[i].size = block->used;
+  }
+
+  if (!g_output_stream_writev_all(sink->stream, vectors, sink->blocks->len, &written, NULL, &sink->error)) {
+    g_prefix_error(&sink->error, "Could not write output: ");
+  }
+
+  bib_stats_add(bytes_out, written);
+  g_ptr_array_set_size(sink->blocks, 0);
+}
+
+void bib_sink_flush(BIBSink *sink) {
+  if (sink_is_memory(sink) || sink->error != NULL) {
+    return;
+  }
+
+  if (sink->stream != NULL) {
+    sink_flush_stream(sink);
+    return;
+  }
+
+  struct iovec iov[MIN(IOV_MAX, 64)];
+  guint first = 0;
+  gsize offset = 0;
+
+  while (first < sink->blocks->len) {
+    gint count = 0;
+
+    for (guint i = first; i < sink->blocks->len && count < (gint)G_N_ELEMENTS(iov); i++) {
+      struct BIBSinkBlock *block = g_ptr_array_index(sink->blocks, i);
+      gsize skip = i == first ? offset : 0;
+      iov[count].iov_base = block->data + skip;
+      iov[count].iov_len = block->used - skip;
+      count++;
+    }
+
+    gssize written = writev(sink->fd, iov, count);
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (written < 0) {
+      int saved_errno = errno;
+      g_set_error(&sink->error, G_IO_ERROR, g_io_error_from_errno(saved_errno), "Could not write output: %s", g_strerror(saved_errno));
+      return;
+    }
+
+    bib_stats_add(bytes_out, written);
+
+    // Skip past what was written, which may end in the middle of a block.
+    while (written > 0) {
+      struct BIBSinkBlock *block = g_ptr_array_index(sink->blocks, first);
+      gsize left = block->used - offset;
+
+      if ((gsize)written < left) {
+        offset += written;
+        written = 0;
+      } else {
+        written -= left;
+        offset = 0;
+        first++;
+      }
+    }
+
+    while (first < sink->blocks->len && ((struct BIBSinkBlock *)g_ptr_array_index(sink->blocks, first))->used == offset) {
+      first++;
+      offset = 0;
+    }
+  }
+
+  g_ptr_array_set_size(sink->blocks, 0);
+}
+
+GBytes *bib_sink_free_to_bytes(BIBSink *sink) {
+  gsize length = 0;
+
+  for (guint i = 0; i < sink->blocks->len; i++) {
+    length += ((struct BIBSinkBlock *)g_ptr_array_index(sink->blocks, i))->used;
+  }
+
+  gchar *data = g_malloc(length + 1);
+  gsize position = 0;
+
+  for (guint i = 0; i < sink->blocks->len; i++) {
+    struct BIBSinkBlock *block = g_ptr_array_index(sink->blocks, i);
+    memcpy(data + position, block->data, block->used);
+    position += block->used;
+  }
+
+  data[length] = '\0';
+  bib_sink_free(sink);
+
+  return g_bytes_new_take(data, length);
+}
+
+// Flushes what is left and frees the sink, reporting the first write error.
+gboolean bib_sink_close(BIBSink *sink, GError **error) {
+  bib_sink_flush(sink);
+
+  if (sink->stream != NULL && sink->error == NULL && !g_output_stream_close(sink->stream, NULL, &sink->error)) {
+    g_prefix_error(&sink->error, "Could not write output: ");
+  }
+
+  if (sink->error != NULL) {
+    g_propagate_error(error, g_steal_pointer(&sink->error));
+    bib_sink_free(sink);
+    return FALSE;
+  }
+
+  bib_sink_free(sink);
+  return TRUE;
+}
+
+void bib_sink_free(gpointer ptr) {
+  BIBSink *sink = ptr;
+
+  if (sink == NULL) {
+    return;
+  }
+
+  g_ptr_array_unref(sink->blocks);
+  g_clear_object(&sink->stream);
+  g_clear_error(&sink->error);
+  g_free(sink);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+// Entries are ordered by key, ignoring ASCII case, and stably, so that among
+// equal keys the first in the input stays first. The order is the one of
+// bib_string_casecmp, which the stream merge and --watch rely on as well.
+//
+// Each entry gets its first bytes folded to lowercase and packed into an
+// integer up front, so most comparisons are a single integer compare and only
+// keys sharing that prefix go back to the strings. The sort itself is a merge
+// sort: large lists are cut into one run per thread, the runs are sorted in
+// parallel, and then merged pairwise, each round of merges in parallel too.
+
+#define BIB_SORT_INSERTION 16
+#define BIB_SORT_PARALLEL 16384
+
+struct sort_key {
+  guint64 prefix;
+  BIBEntry *entry;
+};
+
+struct sort_task {
+  struct sort_key *keys;
+  struct sort_key *tmp;
+  gsize start;
+  gsize middle;
+  gsize end;
+};
+
+static guint64 sort_prefix(const BIBString *key) {
+  guint64 prefix = 0;
+
+  for (gsize i = 0; i < sizeof(prefix); i++) {
+    guchar c = i < key->len ? g_ascii_tolower(key->str[i]) : 0;
+    prefix = (prefix << 8) | c;
+  }
+
+  return prefix;
+}
+
+static gint sort_compare(const struct sort_key *a, const struct sort_key *b) {
+  if (a->prefix != b->prefix) {
+    return a->prefix < b->prefix ? -1 : 1;
+  }
+
+  return bib_string_casecmp(&a->entry->key, &b->entry->key);
+}
+
+// Merges the sorted ranges [start, middle) and [middle, end) of `src` into the
+// same range of `dst`. Ties go to the left, which keeps the sort stable.
+static void sort_merge(const struct sort_key *src, struct sort_key *dst, gsize start, gsize middle, gsize end) {
+  gsize i = start;
+  gsize j = middle;
+  gsize k = start;
+
+  while (i < middle && j < end) {
+    dst[k++] = sort_compare(&src[j], &src[i]) < 0 ? src[j++] : src[i++];
+  }
+
+  while (i < middle) {
+    dst[k++] = src[i++];
+  }
+
+  while (j < end) {
+    dst[k++] = src[j++];
+  }
+}
+
+// Sorts keys[start, end), using the same range of `tmp` as scratch space.
+static void sort_range(struct sort_key *keys, struct sort_key *tmp, gsize start, gsize end) {
+  if (end - start <= BIB_SORT_INSERTION) {
+    for (gsize i = start + 1; i < end; i++) {
+      struct sort_key key = keys[i];
+      gsize j = i;
+      while (j > start && sort_compare(&key, &keys[j - 1]) < 0) {
+        keys[j] = keys[j - 1];
+        j--;
+      }
+      keys[j] = key;
+    }
+    return;
+  }
+
+  gsize middle = start + (end - start) / 2;
+  sort_range(keys, tmp, start, middle);
+  sort_range(keys, tmp, middle, end);
+
+  if (sort_compare(&keys[middle], &keys[middle - 1]) >= 0) {
+    return;
+  }
+
+  memcpy(tmp + start, keys + start, (end - start) * sizeof(*keys));
+  sort_merge(tmp, keys, start, middle, end);
+}
+
+static void sort_run(gpointer data, gpointer user_data) {
+  struct sort_task *task = data;
+  sort_range(task->keys, task->tmp, task->start, task->end);
+}
+
+static void sort_merge_runs(gpointer data, gpointer user_data) {
+  struct sort_task *task = data;
+  sort_merge(task->keys, task->tmp, task->start, task->middle, task->end);
+}
+
+void bib_entry_list_sort(BIBEntryList *list, guint jobs) {
+  GPtrArray *entries = list->entries;
+  gsize n = entries->len;
+
+  if (n < 2) {
+    return;
+  }
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+
+  g_autofree struct sort_key *keys = g_new(struct sort_key, n);
+  g_autofree struct sort_key *tmp = g_new(struct sort_key, n);
+
+  for (gsize i = 0; i < n; i++) {
+    BIBEntry *entry = g_ptr_array_index(entries, i);
+    keys[i].prefix = sort_prefix(&entry->key);
+    keys[i].entry = entry;
+  }
+
+  gsize n_runs = n >= BIB_SORT_PARALLEL ? MIN(jobs, n / (BIB_SORT_PARALLEL / 2)) : 1;
+  n_runs = MAX(n_runs, 1);
+  g_autofree gsize *bounds = g_new(gsize, n_runs + 1);
+  g_autofree struct sort_task *tasks = g_new0(struct sort_task, n_runs);
+
+  for (gsize i = 0; i <= n_runs; i++) {
+    bounds[i] = n * i / n_runs;
+  }
+
+  for (gsize i = 0; i < n_runs; i++) {
+    tasks[i] = (struct sort_task){.keys = keys, .tmp = tmp, .start = bounds[i], .end = bounds[i + 1]};
+  }
+
+  bib_parallel_for(tasks, n_runs, sizeof(*tasks), sort_run, NULL, jobs);
+
+  // Each round merges neighbouring runs from one buffer into the other.
+  struct sort_key *src = keys;
+  struct sort_key *dst = tmp;
+
+  for (gsize width = 1; width < n_runs; width *= 2) {
+    gsize count = 0;
+
+    for (gsize i = 0; i < n_runs; i += 2 * width) {
+      tasks[count++] = (struct sort_task){
+          .keys = src,
+          .tmp = dst,
+          .start = bounds[i],
+          .middle = bounds[MIN(i + width, n_runs)],
+          .end = bounds[MIN(i + 2 * width, n_runs)],
+      };
+    }
+
+    bib_parallel_for(tasks, count, sizeof(*tasks), sort_merge_runs, NULL, jobs);
+
+    struct sort_key *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  for (gsize i = 0; i < n; i++) {
+    g_ptr_array_index(entries, i) = src[i].entry;
+  }
+
+  bib_stats_stop(&timer, BIB_PHASE_SORT);
+}
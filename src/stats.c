@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <time.h>
+
+// Counters are only touched when --stats is given, so a normal run pays a
+// single predictable branch for each of them. CPU time is that of the whole
+// process, so it includes the worker threads of a phase; phases of different
+// files in --batch overlap, and then add up to more than the run took.
+
+struct BIBStats bib_stats;
+
+G_LOCK_DEFINE_STATIC(stats);
+
+static const gchar *phase_names[BIB_PHASE_COUNT] = {
+    [BIB_PHASE_READ] = "read",
+    [BIB_PHASE_CACHE] = "cache",
+    [BIB_PHASE_PARSE] = "parse",
+    [BIB_PHASE_CONVERT] = "convert",
+    [BIB_PHASE_SORT] = "sort",
+    [BIB_PHASE_PRINT] = "print",
+};
+
+static const struct {
+  const gchar *name;
+  gsize offset;
+} counters[] = {
+    {"entries",      G_STRUCT_OFFSET(struct BIBStats, entries)     },
+    {"fields",       G_STRUCT_OFFSET(struct BIBStats, fields)      },
+    {"bytes_in",     G_STRUCT_OFFSET(struct BIBStats, bytes_in)    },
+    {"bytes_out",    G_STRUCT_OFFSET(struct BIBStats, bytes_out)   },
+    {"normalized",   G_STRUCT_OFFSET(struct BIBStats, normalized)  },
+    {"duplicates",   G_STRUCT_OFFSET(struct BIBStats, duplicates)  },
+    {"declined",     G_STRUCT_OFFSET(struct BIBStats, declined)    },
+    {"arena_blocks", G_STRUCT_OFFSET(struct BIBStats, arena_blocks)},
+    {"arena_bytes",  G_STRUCT_OFFSET(struct BIBStats, arena_bytes) },
+    {"sink_blocks",  G_STRUCT_OFFSET(struct BIBStats, sink_blocks) },
+};
+
+static gint64 cpu_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+void bib_stats_enable(BIBStatsFormat format) {
+  bib_stats.format = format;
+}
+
+void bib_stats_start(BIBStatsTimer *timer) {
+  if (G_LIKELY(bib_stats.format == BIB_STATS_OFF)) {
+    return;
+  }
+
+  timer->wall = g_get_monotonic_time();
+  timer->cpu = cpu_time();
+}
+
+void bib_stats_stop(BIBStatsTimer *timer, BIBStatsPhase phase) {
+  if (G_LIKELY(bib_stats.format == BIB_STATS_OFF)) {
+    return;
+  }
+
+  gint64 wall = g_get_monotonic_time() - timer->wall;
+  gint64 cpu = cpu_time() - timer->cpu;
+
+  G_LOCK(stats);
+  bib_stats.wall[phase] += wall;
+  bib_stats.cpu[phase] += cpu;
+  G_UNLOCK(stats);
+}
+
+// Written to stderr in one go, so it does not interleave with other messages.
+void bib_stats_report(void) {
+  if (bib_stats.format == BIB_STATS_OFF) {
+    return;
+  }
+
+  g_autoptr(GString) out = g_string_new(NULL);
+  gboolean json = bib_stats.format == BIB_STATS_JSON;
+
+  if (json) {
+    g_string_append(out, "{\"phases\": {");
+  } else {
+    g_string_append_printf(out, "%-12s %12s %12s\n", "phase", "wall ms", "cpu ms");
+  }
+
+  for (gint i = 0; i < BIB_PHASE_COUNT; i++) {
+    gint64 wall = bib_stats.wall[i];
+    gint64 cpu = bib_stats.cpu[i];
+
+    // Microseconds as integers in JSON, so no locale gets in the way.
+    if (json) {
+      g_string_append_printf(out, "%s\"%s\": {\"wall_us\": %" G_GINT64_FORMAT ", \"cpu_us\": %" G_GINT64_FORMAT "}", i > 0 ? ", " : "", phase_names[i], wall, cpu);
+    } else {
+      g_string_append_printf(out, "%-12s %12.3f %12.3f\n", phase_names[i], wall / 1e3, cpu / 1e3);
+    }
+  }
+
+  if (json) {
+    g_string_append(out, "}");
+  } else {
+    g_string_append_c(out, '\n');
+  }
+
+  for (gsize i = 0; i < G_N_ELEMENTS(counters); i++) {
+    gsize value = G_STRUCT_MEMBER(gsize, &bib_stats, counters[i].offset);
+
+    if (json) {
+      g_string_append_printf(out, ", \"%s\": %" G_GSIZE_FORMAT, counters[i].name, value);
+    } else {
+      g_string_append_printf(out, "%-12s %12" G_GSIZE_FORMAT "\n", counters[i].name, value);
+    }
+  }
+
+  if (json) {
+    g_string_append(out, "}\n");
+  }
+
+  g_printerr("%s", out->str);
+}
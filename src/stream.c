@@ -0,0 +1,519 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+
+// Streaming conversion. The input is cut into chunks at top-level `@` entry
+// boundaries, each chunk is parsed, converted and spilled to a temporary run
+// file sorted by key, and the runs are merged into the output at the end. Only
+// one chunk and one record per run are ever held in memory.
+//
+// Every run keeps its file open, so no more than BIB_STREAM_FAN_IN are merged
+// at once. Whenever that many runs of the same level pile up at the end, they
+// are merged into one run of the next level; at the end, the last ones are
+// merged until few enough are left for the final merge. Runs stay in input
+// order throughout, so that ties still go to the first entry.
+
+#define BIB_STREAM_BLOCK_SIZE (64 * 1024)
+#define BIB_STREAM_FAN_IN 32
+
+struct run {
+  FILE *file;
+  GString *key;
+  GString *text;
+  guint level;
+  gboolean failed;
+};
+
+typedef void (*run_func)(struct run *run, gpointer user_data);
+
+struct stream {
+  BIBOutputFormat format;
+  gboolean bibtex;
+  guint jobs;
+  GPtrArray *runs;
+};
+
+void bib_splitter_scan(BIBSplitter *splitter, const gchar *text, gsize length) {
+  for (gsize i = splitter->scanned; i < length; i++) {
+    gchar c = text[i];
+
+    if (splitter->close == '\0') {
+      if (c == '@') {
+        splitter->boundary = i;
+        splitter->header = TRUE;
+      } else if (splitter->header && (c == '{' || c == '(')) {
+        splitter->close = c == '{' ? '}' : ')';
+        splitter->header = FALSE;
+      }
+      continue;
+    }
+
+    switch (c) {
+      case '{':
+        splitter->depth++;
+        break;
+      case '}':
+        if (splitter->depth > 0) {
+          splitter->depth--;
+        } else if (splitter->close == '}' && !splitter->quoted) {
+          splitter->close = '\0';
+        }
+        break;
+      case ')':
+        if (splitter->depth == 0 && splitter->close == ')' && !splitter->quoted) {
+          splitter->close = '\0';
+        }
+        break;
+      case '"':
+        if (splitter->depth == 0) {
+          splitter->quoted = !splitter->quoted;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  splitter->scanned = length;
+}
+
+void bib_splitter_consume(BIBSplitter *splitter, gsize length) {
+  splitter->scanned -= length;
+  splitter->boundary = splitter->boundary > length ? splitter->boundary - length : 0;
+}
+
+static void run_free(gpointer ptr) {
+  struct run *run = ptr;
+  if (run->file != NULL) {
+    fclose(run->file);
+  }
+  g_string_free(run->key, TRUE);
+  g_string_free(run->text, TRUE);
+  g_free(run);
+}
+
+static gboolean set_errno_error(GError **error, const gchar *what) {
+  int saved_errno = errno;
+  g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno), "%s: %s", what, g_strerror(saved_errno));
+  return FALSE;
+}
+
+static gboolean run_write_record(FILE *file, const gchar *data, guint64 length) {
+  return fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(data, 1, length, file) == length;
+}
+
+static gboolean run_read_record(FILE *file, GString *record) {
+  guint64 length = 0;
+
+  if (fread(&length, sizeof(length), 1, file) != 1) {
+    return FALSE;
+  }
+
+  g_string_set_size(record, length);
+  return fread(record->str, 1, length, file) == length;
+}
+
+// Returns FALSE at the end of the run, or with `failed` set when it could not
+// be read or ends within a record.
+static gboolean run_next(struct run *run) {
+  int c = fgetc(run->file);
+
+  if (c == EOF) {
+    run->failed = ferror(run->file);
+    return FALSE;
+  }
+
+  ungetc(c, run->file);
+
+  if (!run_read_record(run->file, run->key) || !run_read_record(run->file, run->text)) {
+    run->failed = TRUE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean run_failed(struct run *run, GError **error) {
+  if (ferror(run->file)) {
+    return set_errno_error(error, "Could not read run file");
+  }
+
+  g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Truncated run file");
+  return FALSE;
+}
+
+// The run is added to `runs` even when opening its file fails, to be freed
+// along with the others.
+static struct run *run_new(GPtrArray *runs, GError **error) {
+  g_autofree gchar *path = NULL;
+  gint fd = g_file_open_tmp("bib-converter-XXXXXX.run", &path, error);
+
+  if (fd < 0) {
+    return NULL;
+  }
+
+  struct run *run = g_new0(struct run, 1);
+  run->file = fdopen(fd, "w+b");
+  run->key = g_string_new(NULL);
+  run->text = g_string_new(NULL);
+  g_unlink(path);
+  g_ptr_array_add(runs, run);
+
+  if (run->file == NULL) {
+    g_close(fd, NULL);
+    set_errno_error(error, "Could not open run file");
+    return NULL;
+  }
+
+  return run;
+}
+
+static gboolean run_rewind(struct run *run, GError **error) {
+  if (fflush(run->file) != 0 || fseek(run->file, 0, SEEK_SET) != 0) {
+    return set_errno_error(error, "Could not write run file");
+  }
+
+  return TRUE;
+}
+
+static gboolean stream_collapse(struct stream *stream, GError **error);
+
+static gboolean stream_spill(struct stream *stream, GString *chunk, GError **error) {
+  g_autoptr(GBytes) bytes = g_bytes_new_static(chunk->str, chunk->len);
+  g_autoptr(BIBEntryList) entries = bib_parse(bytes, stream->jobs, error);
+
+  if (entries == NULL) {
+    return FALSE;
+  }
+
+  struct run *run = run_new(stream->runs, error);
+
+  if (run == NULL) {
+    return FALSE;
+  }
+
+  BIBStatsTimer timer;
+  bib_stats_start(&timer);
+
+  for (gsize i = 0; i < entries->entries->len; i++) {
+    BIBEntry *entry = g_ptr_array_index(entries->entries, i);
+    g_autoptr(GBytes) formatted = bib_entry_format(entry, stream->format, stream->bibtex);
+    gsize length = 0;
+    const gchar *text = g_bytes_get_data(formatted, &length);
+
+    if (!run_write_record(run->file, entry->key.str, entry->key.len) ||
+        !run_write_record(run->file, text, length)) {
+      return set_errno_error(error, "Could not write run file");
+    }
+  }
+
+  if (!run_rewind(run, error)) {
+    return FALSE;
+  }
+
+  bib_stats_stop(&timer, BIB_PHASE_PRINT);
+
+  return stream_collapse(stream, error);
+}
+
+static gint run_compare(const struct run *a, const struct run *b) {
+  BIBString key_a = bib_string_view(a->key->str, a->key->len);
+  BIBString key_b = bib_string_view(b->key->str, b->key->len);
+  return bib_string_casecmp(&key_a, &key_b);
+}
+
+// Min-heap of runs ordered by their current key. Runs come from consecutive
+// chunks, so ties go to the lower index to keep the first entry of the input,
+// just like the stable sort of the in-memory path.
+static gboolean heap_less(struct run **heap, guint *index, guint a, guint b) {
+  gint cmp = run_compare(heap[a], heap[b]);
+  return cmp < 0 || (cmp == 0 && index[a] < index[b]);
+}
+
+static void heap_swap(struct run **heap, guint *index, guint a, guint b) {
+  struct run *run = heap[a];
+  guint i = index[a];
+  heap[a] = heap[b];
+  index[a] = index[b];
+  heap[b] = run;
+  index[b] = i;
+}
+
+static void heap_sift_down(struct run **heap, guint *index, guint size, guint i) {
+  while (true) {
+    guint smallest = i;
+    guint left = 2 * i + 1;
+    guint right = 2 * i + 2;
+
+    if (left < size && heap_less(heap, index, left, smallest)) {
+      smallest = left;
+    }
+
+    if (right < size && heap_less(heap, index, right, smallest)) {
+      smallest = right;
+    }
+
+    if (smallest == i) {
+      return;
+    }
+
+    heap_swap(heap, index, i, smallest);
+    i = smallest;
+  }
+}
+
+// Calls `func` on each record of `runs`, in key order, stopping at the first
+// run that cannot be read.
+static gboolean runs_merge(struct run **runs, guint n, run_func func, gpointer user_data, GError **error) {
+  g_autofree struct run **heap = g_new(struct run *, n);
+  g_autofree guint *index = g_new(guint, n);
+  guint size = 0;
+
+  for (guint i = 0; i < n; i++) {
+    if (run_next(runs[i])) {
+      heap[size] = runs[i];
+      index[size] = i;
+      size++;
+    } else if (runs[i]->failed) {
+      return run_failed(runs[i], error);
+    }
+  }
+
+  for (gint i = size / 2 - 1; i >= 0; i--) {
+    heap_sift_down(heap, index, size, i);
+  }
+
+  while (size > 0) {
+    struct run *run = heap[0];
+
+    func(run, user_data);
+
+    if (!run_next(run)) {
+      if (run->failed) {
+        return run_failed(run, error);
+      }
+
+      heap_swap(heap, index, 0, --size);
+    }
+
+    heap_sift_down(heap, index, size, 0);
+  }
+
+  return TRUE;
+}
+
+struct run_output {
+  FILE *file;
+  gboolean failed;
+};
+
+static void run_output_write(struct run *run, gpointer user_data) {
+  struct run_output *output = user_data;
+
+  if (!output->failed &&
+      (!run_write_record(output->file, run->key->str, run->key->len) ||
+       !run_write_record(output->file, run->text->str, run->text->len))) {
+    output->failed = TRUE;
+  }
+}
+
+// Merges the BIB_STREAM_FAN_IN runs at the end into one, one level up.
+// Duplicates are kept, they are only dropped by the final merge.
+static gboolean stream_merge_last(struct stream *stream, GError **error) {
+  guint first = stream->runs->len - BIB_STREAM_FAN_IN;
+  struct run *merged = run_new(stream->runs, error);
+
+  if (merged == NULL) {
+    return FALSE;
+  }
+
+  struct run **runs = (struct run **)stream->runs->pdata + first;
+
+  struct run_output output = {.file = merged->file};
+  if (!runs_merge(runs, BIB_STREAM_FAN_IN, run_output_write, &output, error)) {
+    return FALSE;
+  }
+
+  merged->level = runs[BIB_STREAM_FAN_IN - 1]->level + 1;
+
+  if (output.failed) {
+    return set_errno_error(error, "Could not write run file");
+  }
+
+  if (!run_rewind(merged, error)) {
+    return FALSE;
+  }
+
+  g_ptr_array_remove_range(stream->runs, first, BIB_STREAM_FAN_IN);
+  return TRUE;
+}
+
+// Levels only go down towards the end, so the last runs are of the same
+// level when the first of them and the last one are.
+static gboolean stream_collapse(struct stream *stream, GError **error) {
+  GPtrArray *runs = stream->runs;
+
+  while (runs->len >= BIB_STREAM_FAN_IN &&
+         ((struct run *)g_ptr_array_index(runs, runs->len - BIB_STREAM_FAN_IN))->level ==
+             ((struct run *)g_ptr_array_index(runs, runs->len - 1))->level) {
+    if (!stream_merge_last(stream, error)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+// As in bib_entry_list_print, keys are sorted ignoring case but compared
+// exactly, so duplicates need not be next to each other; they are only within
+// the same group of keys equal ignoring case, which is contiguous. `keys`
+// holds the exact keys of the current group, the last one being `last_key`.
+struct merge_output {
+  BIBSink *out;
+  const BIBOutputFrame *frame;
+  GString *last_key;
+  GHashTable *keys;
+  gboolean printed;
+};
+
+static void merge_output_write(struct run *run, gpointer user_data) {
+  struct merge_output *output = user_data;
+  BIBString key = bib_string_view(run->key->str, run->key->len);
+  BIBString last_key = bib_string_view(output->last_key->str, output->last_key->len);
+
+  if (bib_string_casecmp(&key, &last_key) != 0) {
+    g_hash_table_remove_all(output->keys);
+  }
+
+  g_string_truncate(output->last_key, 0);
+  g_string_append_len(output->last_key, run->key->str, run->key->len);
+
+  if (!g_hash_table_add(output->keys, g_strndup(run->key->str, run->key->len))) {
+    g_printerr("Skipping duplicate key %s\n", output->last_key->str);
+    bib_stats_add(duplicates, 1);
+    return;
+  }
+
+  if (output->printed) {
+    bib_sink_append(output->out, output->frame->separator, strlen(output->frame->separator));
+  }
+
+  bib_sink_append(output->out, run->text->str, run->text->len);
+  output->printed = TRUE;
+}
+
+static gboolean stream_merge(struct stream *stream, BIBSink *out, GError **error) {
+  while (stream->runs->len > BIB_STREAM_FAN_IN) {
+    if (!stream_merge_last(stream, error)) {
+      return FALSE;
+    }
+  }
+
+  g_autoptr(GString) last_key = g_string_new(NULL);
+  g_autoptr(GHashTable) keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  struct merge_output output = {.out = out, .frame = bib_output_frame(stream->format), .last_key = last_key, .keys = keys};
+
+  bib_sink_append(out, output.frame->open, strlen(output.frame->open));
+  if (!runs_merge((struct run **)stream->runs->pdata, stream->runs->len, merge_output_write, &output, error)) {
+    return FALSE;
+  }
+
+  bib_sink_append(out, output.frame->close, strlen(output.frame->close));
+
+  return TRUE;
+}
+
+// Write errors are left in `out`, to be reported when it is closed.
+gboolean bib_stream_convert(GInputStream *in, BIBSink *out, gsize chunk_size, BIBOutputFormat format, gboolean bibtex, guint jobs, GError **error) {
+  struct stream stream = {.format = format, .bibtex = bibtex, .jobs = jobs};
+  g_autoptr(GPtrArray) runs = stream.runs = g_ptr_array_new_with_free_func(run_free);
+  BIBSplitter splitter = {0};
+  g_autoptr(GString) pending = g_string_sized_new(chunk_size + BIB_STREAM_BLOCK_SIZE);
+  gssize length;
+
+  while (true) {
+    gsize old_length = pending->len;
+    BIBStatsTimer timer;
+    bib_stats_start(&timer);
+    g_string_set_size(pending, old_length + BIB_STREAM_BLOCK_SIZE);
+    length = g_input_stream_read(in, pending->str + old_length, BIB_STREAM_BLOCK_SIZE, NULL, error);
+    g_string_set_size(pending, old_length + MAX(length, 0));
+    bib_stats_stop(&timer, BIB_PHASE_READ);
+    bib_stats_add(bytes_in, MAX(length, 0));
+
+    if (length < 0) {
+      return FALSE;
+    }
+
+    if (length == 0) {
+      break;
+    }
+
+    bib_splitter_scan(&splitter, pending->str, pending->len);
+
+    if (pending->len < chunk_size || splitter.boundary == 0) {
+      continue;
+    }
+
+    // The chunk keeps the large buffer, only the incomplete entry is copied.
+    g_autoptr(GString) chunk = pending;
+    pending = g_string_sized_new(chunk_size + BIB_STREAM_BLOCK_SIZE);
+    g_string_append_len(pending, chunk->str + splitter.boundary, chunk->len - splitter.boundary);
+    g_string_truncate(chunk, splitter.boundary);
+    bib_splitter_consume(&splitter, splitter.boundary);
+
+    if (!stream_spill(&stream, chunk, error)) {
+      return FALSE;
+    }
+  }
+
+  if (stream.runs->len == 0) {
+    // Everything fit in a single chunk, there is nothing to merge.
+    g_autoptr(GBytes) bytes = g_bytes_new_static(pending->str, pending->len);
+    g_autoptr(BIBEntryList) entries = bib_parse(bytes, jobs, error);
+
+    if (entries == NULL) {
+      return FALSE;
+    }
+
+    BIBStatsTimer timer;
+    bib_stats_start(&timer);
+    bib_entry_list_print(out, entries, format, bibtex, jobs);
+    bib_stats_stop(&timer, BIB_PHASE_PRINT);
+  } else if (stream_spill(&stream, pending, error)) {
+    BIBStatsTimer timer;
+    bib_stats_start(&timer);
+    gboolean ok = stream_merge(&stream, out, error);
+    bib_stats_stop(&timer, BIB_PHASE_PRINT);
+
+    if (!ok) {
+      return FALSE;
+    }
+  } else {
+    return FALSE;
+  }
+
+  if (format == BIB_OUTPUT_BIB) {
+    bib_sink_append(out, "\n", 1);
+  }
+
+  return TRUE;
+}
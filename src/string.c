@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <string.h>
+
+BIBString bib_string_view(const gchar *str, gsize len) {
+  BIBString string = {.str = str, .len = len, .owned = NULL, .pending = FALSE};
+  return string;
+}
+
+BIBString bib_string_take(gchar *str) {
+  BIBString string = {.str = str, .len = strlen(str), .owned = str, .pending = FALSE};
+  return string;
+}
+
+BIBString bib_string_pending(const gchar *str, gsize len) {
+  BIBString string = {.str = str, .len = len, .owned = NULL, .pending = len > 0};
+  return string;
+}
+
+// Returns the normalized text. The result never shares ownership with
+// `string`, so it must always be released with bib_string_clear.
+BIBString bib_string_resolve(const BIBString *string) {
+  if (string->pending) {
+    return bib_normalize(string->str, string->len);
+  }
+
+  return bib_string_view(string->str, string->len);
+}
+
+void bib_string_clear(BIBString *string) {
+  g_free(string->owned);
+  string->str = NULL;
+  string->len = 0;
+  string->owned = NULL;
+  string->pending = FALSE;
+}
+
+gchar *bib_string_dup(const BIBString *string) {
+  return g_strndup(string->str, string->len);
+}
+
+gboolean bib_string_equal(const BIBString *a, const BIBString *b) {
+  return a->len == b->len && memcmp(a->str, b->str, a->len) == 0;
+}
+
+// FNV-1a, for hash tables keyed by BIBString.
+guint bib_string_hash(const BIBString *string) {
+  guint hash = 2166136261u;
+
+  for (gsize i = 0; i < string->len; i++) {
+    hash = (hash ^ (guchar)string->str[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+gboolean bib_string_caseeq(const BIBString *string, const gchar *literal) {
+  gsize len = strlen(literal);
+  return string->len == len && g_ascii_strncasecmp(string->str, literal, len) == 0;
+}
+
+gint bib_string_casecmp(const BIBString *a, const BIBString *b) {
+  gsize len = MIN(a->len, b->len);
+
+  for (gsize i = 0; i < len; i++) {
+    gint c1 = (guchar)g_ascii_tolower(a->str[i]);
+    gint c2 = (guchar)g_ascii_tolower(b->str[i]);
+    if (c1 != c2) {
+      return c1 - c2;
+    }
+  }
+
+  return (a->len > len ? (guchar)g_ascii_tolower(a->str[len]) : 0) -
+         (b->len > len ? (guchar)g_ascii_tolower(b->str[len]) : 0);
+}
+
+void bib_string_down(BIBString *string) {
+  for (gsize i = 0; i < string->len; i++) {
+    guchar c = string->str[i];
+    if (c >= 0x80 || g_ascii_isupper(c)) {
+      gchar *down = g_utf8_strdown(string->str, string->len);
+      bib_string_clear(string);
+      *string = bib_string_take(down);
+      return;
+    }
+  }
+}
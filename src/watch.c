@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "internal.h"
+
+#include <stdlib.h>
+
+// Watch mode keeps the tree and the formatted text of every entry from the
+// previous run. On each save the edited byte range is handed to tree-sitter,
+// which reparses reusing the old tree, and only entries touched by the edit
+// are converted again.
+
+struct watch_record {
+  uint32_t start;
+  uint32_t end;
+  BIBString key;
+  GBytes *text;
+};
+
+struct watch_state {
+  GFile *file;
+  const struct options *options;
+  GBytes *contents;
+  TSTree *tree;
+  GArray *records;
+};
+
+static void watch_record_clear(gpointer data) {
+  struct watch_record *record = data;
+  bib_string_clear(&record->key);
+  g_clear_pointer(&record->text, g_bytes_unref);
+}
+
+static void watch_reset(struct watch_state *state) {
+  g_clear_pointer(&state->contents, g_bytes_unref);
+  g_clear_pointer(&state->tree, ts_tree_delete);
+  g_clear_pointer(&state->records, g_array_unref);
+}
+
+// Assumes a single contiguous edit: whatever lies between the common prefix
+// and the common suffix of both versions was replaced.
+static TSInputEdit watch_edit(const gchar *old, gsize old_length, const gchar *new, gsize new_length) {
+  gsize limit = MIN(old_length, new_length);
+  gsize prefix = 0;
+  gsize suffix = 0;
+
+  while (prefix < limit && old[prefix] == new[prefix]) {
+    prefix++;
+  }
+
+  while (suffix < limit - prefix && old[old_length - suffix - 1] == new[new_length - suffix - 1]) {
+    suffix++;
+  }
+
+  TSInputEdit edit = {.start_byte = prefix, .old_end_byte = old_length - suffix, .new_end_byte = new_length - suffix};
+  gsize position = 0;
+
+  edit.start_point = bib_advance_point(new, &position, (TSPoint){0, 0}, prefix);
+  edit.new_end_point = bib_advance_point(new, &position, edit.start_point, edit.new_end_byte);
+  position = prefix;
+  edit.old_end_point = bib_advance_point(old, &position, edit.start_point, edit.old_end_byte);
+
+  return edit;
+}
+
+static gint watch_record_find(gconstpointer a, gconstpointer b) {
+  const uint32_t *start = a;
+  const struct watch_record *record = b;
+  return (*start > record->start) - (*start < record->start);
+}
+
+// Returns the record of the previous run for an entry node that the edit did
+// not touch, or NULL if the entry has to be converted again.
+static struct watch_record *watch_reusable(struct watch_state *state, const TSInputEdit *edit, const TSRange *changed, uint32_t n_changed, uint32_t start, uint32_t end) {
+  if (start <= edit->new_end_byte && end >= edit->start_byte) {
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < n_changed; i++) {
+    if (start < changed[i].end_byte && end > changed[i].start_byte) {
+      return NULL;
+    }
+  }
+
+  uint32_t old_start = start;
+  uint32_t old_end = end;
+
+  if (start > edit->new_end_byte) {
+    old_start = start - edit->new_end_byte + edit->old_end_byte;
+    old_end = end - edit->new_end_byte + edit->old_end_byte;
+  }
+
+  struct watch_record *record = bsearch(&old_start, state->records->data, state->records->len, sizeof(struct watch_record), watch_record_find);
+
+  if (record == NULL || record->end != old_end || record->text == NULL) {
+    return NULL;
+  }
+
+  return record;
+}
+
+static gint watch_record_compare(gconstpointer a, gconstpointer b) {
+  const struct watch_record *record1 = *((struct watch_record **)a);
+  const struct watch_record *record2 = *((struct watch_record **)b);
+  gint cmp = bib_string_casecmp(&record1->key, &record2->key);
+  return cmp != 0 ? cmp : (record1->start > record2->start) - (record1->start < record2->start);
+}
+
+static gboolean watch_write(GArray *records, const gchar *path, BIBOutputFormat format, GError **error) {
+  g_autoptr(GPtrArray) sorted = g_ptr_array_sized_new(records->len);
+  gsize length = 1;
+
+  for (guint i = 0; i < records->len; i++) {
+    struct watch_record *record = &g_array_index(records, struct watch_record, i);
+    g_ptr_array_add(sorted, record);
+    length += g_bytes_get_size(record->text);
+  }
+
+  g_ptr_array_sort(sorted, watch_record_compare);
+
+  const BIBOutputFrame *frame = bib_output_frame(format);
+  g_autoptr(GString) out = g_string_sized_new(length);
+  g_autoptr(GHashTable) seen = g_hash_table_new((GHashFunc)bib_string_hash, (GEqualFunc)bib_string_equal);
+
+  g_string_append(out, frame->open);
+
+  for (guint i = 0; i < sorted->len; i++) {
+    struct watch_record *record = g_ptr_array_index(sorted, i);
+    if (!g_hash_table_add(seen, &record->key)) {
+      g_printerr("Skipping duplicate key %.*s\n", bib_string_args(&record->key));
+      bib_stats_add(duplicates, 1);
+      continue;
+    }
+    if (g_hash_table_size(seen) > 1) {
+      g_string_append(out, frame->separator);
+    }
+    gsize text_length = 0;
+    const gchar *text = g_bytes_get_data(record->text, &text_length);
+    g_string_append_len(out, text, text_length);
+  }
+
+  g_string_append(out, frame->close);
+
+  if (format == BIB_OUTPUT_BIB) {
+    g_string_append_c(out, '\n');
+  }
+
+  return g_file_set_contents(path, out->str, out->len, error);
+}
+
+static gboolean watch_convert(struct watch_state *state, GBytes *contents, GError **error) {
+  gsize length = 0;
+  const gchar *source = g_bytes_get_data(contents, &length);
+  TSInputEdit edit = {0};
+  TSRange *changed = NULL;
+  uint32_t n_changed = 0;
+
+  if (state->tree != NULL) {
+    gsize old_length = 0;
+    const gchar *old_source = g_bytes_get_data(state->contents, &old_length);
+    edit = watch_edit(old_source, old_length, source, length);
+    ts_tree_edit(state->tree, &edit);
+  }
+
+  g_autoptr(TSTree) tree = ts_parser_parse_string(bib_parser(), state->tree, source, length);
+
+  if (state->tree != NULL) {
+    changed = ts_tree_get_changed_ranges(state->tree, tree, &n_changed);
+  }
+
+  g_autoptr(GArray) records = g_array_new(FALSE, TRUE, sizeof(struct watch_record));
+  g_array_set_clear_func(records, watch_record_clear);
+  g_auto(TSTreeCursor) cursor = ts_tree_cursor_new(ts_tree_root_node(tree));
+  g_autoptr(BIBArena) arena = bib_arena_new();
+  guint reused = 0;
+
+  for (bool has_child = ts_tree_cursor_goto_first_child(&cursor); has_child; has_child = ts_tree_cursor_goto_next_sibling(&cursor)) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    if (!ts_node_is_named(node) || g_strcmp0(ts_node_type(node), "entry") != 0) {
+      continue;
+    }
+
+    struct watch_record record = {.start = ts_node_start_byte(node), .end = ts_node_end_byte(node)};
+    struct watch_record *old = NULL;
+
+    if (state->tree != NULL) {
+      old = watch_reusable(state, &edit, changed, n_changed, record.start, record.end);
+    }
+
+    if (old != NULL) {
+      record.key = old->key;
+      record.text = old->text;
+      old->key = (BIBString){0};
+      old->text = NULL;
+      reused++;
+    } else {
+      GError *fn_error = NULL;
+      BIBEntry *entry = bib_parse_entry(&cursor, source, arena, &fn_error);
+
+      if (fn_error != NULL) {
+        free(changed);
+        g_propagate_error(error, fn_error);
+        return FALSE;
+      }
+
+      record.key = bib_string_take(bib_string_dup(&entry->key));
+      record.text = bib_entry_format(entry, state->options->output_format, state->options->bibtex);
+    }
+
+    g_array_append_val(records, record);
+  }
+
+  free(changed);
+
+  if (!watch_write(records, state->options->output, state->options->output_format, error)) {
+    return FALSE;
+  }
+
+  g_printerr("Wrote %s (%u of %u entries converted)\n", state->options->output, records->len - reused, records->len);
+
+  watch_reset(state);
+  state->contents = g_bytes_ref(contents);
+  state->tree = g_steal_pointer(&tree);
+  state->records = g_steal_pointer(&records);
+
+  return TRUE;
+}
+
+static void watch_update(struct watch_state *state) {
+  g_autoptr(GError) error = NULL;
+  gchar *data = NULL;
+  gsize length = 0;
+
+  // Read into memory rather than mapping: editors often rewrite the file in
+  // place, and the previous contents are needed to find what was edited.
+  if (!g_file_load_contents(state->file, NULL, &data, &length, NULL, &error)) {
+    g_printerr("Error reading file: %s\n", error->message);
+    return;
+  }
+
+  g_autoptr(GBytes) contents = g_bytes_new_take(data, length);
+
+  if (state->contents != NULL && g_bytes_equal(state->contents, contents)) {
+    return;
+  }
+
+  if (!watch_convert(state, contents, &error)) {
+    g_printerr("Error: %s\n", error->message);
+    // The old tree may already have been edited, so start over next time.
+    watch_reset(state);
+  }
+}
+
+static void watch_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event, gpointer user_data) {
+  switch (event) {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      watch_update(user_data);
+      break;
+    default:
+      break;
+  }
+}
+
+gboolean bib_watch(const gchar *path, const struct options *options) {
+  g_autoptr(GFile) file = g_file_new_for_commandline_arg(path);
+  g_autoptr(GError) error = NULL;
+  struct watch_state state = {.file = file, .options = options};
+
+  g_autoptr(GFileMonitor) monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+
+  if (monitor == NULL) {
+    g_printerr("Error watching file: %s\n", error->message);
+    return FALSE;
+  }
+
+  g_signal_connect(monitor, "changed", G_CALLBACK(watch_changed), &state);
+  watch_update(&state);
+
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_main_loop_run(loop);
+
+  watch_reset(&state);
+
+  return TRUE;
+}
@@ -0,0 +1,431 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Álan Crístoffer e Sousa.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+"""Generates src/mappings.h and src/mappings.c.
+
+The BibTeX <-> biblatex type and field mappings live here, and are compiled
+into static tables with a perfect hash (hash and displace), so looking up a
+name costs two hashes and one compare no matter how many mappings there are.
+
+Run it from the repository root after changing the tables below, and commit
+the generated files along with it.
+"""
+
+import hashlib
+import json
+import os
+
+# Every field name with a fixed ID. Names not listed here are interned at run
+# time and passed through untouched.
+FIELDS = """
+abstract addendum address afterword annotation annote annotator archiveprefix
+author bookauthor booksubtitle booktitle chapter commentator crossref date doi
+edition editor editora editorb editorc eid eprint eprintclass eprinttype
+eprintype eventdate eventtitle file foreword holder howpublished indextitle
+institution introduction isan isbn ismn isrn issn issue issuetitle journal
+journalsubtitle journaltitle key keywords label langid language library
+location mainsubtitle maintitle month note number organization origdate
+origlanguage origlocation origpublisher pages pagetotal pdf primaryclass
+publisher pubstate school series shorthand sortkey subtitle title titleaddon
+translator type url urldate venue version volume volumes year
+""".split()
+
+# Field renames applied when parsing BibTeX into biblatex. pdf is not renamed
+# to file: file is never printed, and pdf always has been.
+FIELDS_TO_BIBLATEX = {
+    "address": "location",
+    "annote": "annotation",
+    "archiveprefix": "eprinttype",
+    "journal": "journaltitle",
+    "key": "sortkey",
+    "primaryclass": "eprintclass",
+}
+
+# Field renames applied when printing BibTeX. school/institution is left out:
+# which one BibTeX expects depends on the entry type.
+FIELDS_TO_BIBTEX = {
+    "annotation": "annote",
+    "eprintclass": "primaryclass",
+    "eprinttype": "archiveprefix",
+    "journaltitle": "journal",
+    "location": "address",
+    "sortkey": "key",
+}
+
+# Fields never printed.
+FIELDS_SKIP = ["abstract", "file", "keywords"]
+
+# Fields not printed when the entry has a DOI. "eprintype" is the spelling the
+# skip list has always had, kept so such fields are still dropped.
+FIELDS_SKIP_WITH_DOI = ["eprint", "eprintclass", "eprinttype", "eprintype",
+                        "isbn", "issn", "url", "urldate"]
+
+# The order fields are printed in, one group of names per line: names on the
+# same line are spellings of the same field. Known fields not listed here come
+# after, alphabetically, and unknown ones after those.
+FIELDS_ORDER = """
+author
+editor
+editora
+editorb
+editorc
+bookauthor
+translator
+commentator
+annotator
+introduction
+foreword
+afterword
+holder
+title
+subtitle
+titleaddon
+booktitle
+booksubtitle
+maintitle
+mainsubtitle
+issuetitle
+eventtitle
+indextitle
+shorthand
+journaltitle journal
+journalsubtitle
+series
+volume
+volumes
+number
+issue
+eid
+chapter
+pages
+pagetotal
+edition
+version
+eventdate
+venue
+date
+year
+month
+origdate
+publisher
+origpublisher
+organization
+institution
+school
+location address
+origlocation
+howpublished
+type
+language
+origlanguage
+langid
+isbn
+issn
+isan
+ismn
+isrn
+doi
+eprint
+eprintclass primaryclass
+eprinttype archiveprefix eprintype
+url
+urldate
+note
+addendum
+pubstate
+crossref
+sortkey key
+label
+library
+annotation annote
+abstract
+keywords
+file pdf
+""".strip().splitlines()
+
+# Entry types: name -> (biblatex type, value of the type field, BibTeX type).
+# The biblatex type is used when parsing an entry of this type, along with the
+# type field when given; the BibTeX type when printing it. Empty means the
+# name is kept.
+TYPES = {
+    "artwork": ("", "", "misc"),
+    "audio": ("", "", "misc"),
+    "bookinbook": ("", "", "inbook"),
+    "collection": ("", "", "book"),
+    "conference": ("inproceedings", "", ""),
+    "customa": ("", "", "misc"),
+    "customb": ("", "", "misc"),
+    "customc": ("", "", "misc"),
+    "customd": ("", "", "misc"),
+    "custome": ("", "", "misc"),
+    "customf": ("", "", "misc"),
+    "dataset": ("", "", "misc"),
+    "electronic": ("online", "", ""),
+    "image": ("", "", "misc"),
+    "inreference": ("", "", "incollection"),
+    "letter": ("", "", "misc"),
+    "mastersthesis": ("thesis", "mathesis", ""),
+    "movie": ("", "", "misc"),
+    "music": ("", "", "misc"),
+    "mvbook": ("", "", "book"),
+    "mvcollection": ("", "", "book"),
+    "mvproceedings": ("", "", "proceedings"),
+    "mvreference": ("", "", "book"),
+    "online": ("", "", "misc"),
+    "patent": ("", "", "misc"),
+    "performance": ("", "", "misc"),
+    "periodical": ("", "", "misc"),
+    "phdthesis": ("thesis", "phdthesis", ""),
+    "reference": ("", "", "book"),
+    "report": ("", "", "techreport"),
+    "review": ("", "", "misc"),
+    "software": ("", "", "misc"),
+    "standard": ("", "", "misc"),
+    "suppbook": ("", "", "inbook"),
+    "suppcollection": ("", "", "incollection"),
+    "suppperiodical": ("", "", "article"),
+    "techreport": ("report", "techreport", ""),
+    "thesis": ("", "", "phdthesis"),
+    "video": ("", "", "misc"),
+    "www": ("online", "", ""),
+}
+
+HEADER = """/*
+ * Copyright (c) 2024 Álan Crístoffer e Sousa.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Generated by tools/gen-mappings.py, do not edit.
+"""
+
+
+def fnv(seed, name):
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+    for byte in name.encode():
+        h = ((h ^ byte) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def perfect_hash(names):
+    """Hash and displace: names are grouped into buckets by their hash with
+    seed 0, then, biggest bucket first, each bucket gets the smallest seed
+    that puts all of its names into free slots."""
+    size = 1
+    while size < len(names) + len(names) // 4:
+        size *= 2
+    n_buckets = max(size // 4, 1)
+
+    buckets = [[] for _ in range(n_buckets)]
+    for index, name in enumerate(names):
+        buckets[fnv(0, name) % n_buckets].append((index, name))
+
+    seeds = [0] * n_buckets
+    slots = [-1] * size
+
+    for bucket in sorted(range(n_buckets), key=lambda b: -len(buckets[b])):
+        if not buckets[bucket]:
+            continue
+        seed = 1
+        while True:
+            wanted = [fnv(seed, name) % size for _, name in buckets[bucket]]
+            if len(set(wanted)) == len(wanted) and all(slots[s] == -1 for s in wanted):
+                break
+            seed += 1
+        seeds[bucket] = seed
+        for (index, _), slot in zip(buckets[bucket], wanted):
+            slots[slot] = index
+
+    return seeds, slots
+
+
+def c_array(ctype, name, values, per_line=12):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append("    " + ", ".join(str(v) for v in values[i:i + per_line]) + ",")
+    return "static const %s %s[%d] = {\n%s\n};\n" % (ctype, name, len(values), "\n".join(lines))
+
+
+def c_string(value):
+    return '{.str = "%s", .len = %d}' % (value, len(value))
+
+
+def aligned_rows(rows):
+    widths = [max(len(row[i]) for row in rows) for i in range(len(rows[0]))]
+    out = []
+    for row in rows:
+        cells = [cell + "," + " " * (widths[i] - len(cell)) for i, cell in enumerate(row[:-1])]
+        out.append("    {" + " ".join(cells) + " " + row[-1] + "},")
+    return "\n".join(out)
+
+
+def field_id(name):
+    return "BIB_FIELD_" + name.upper()
+
+
+def tables_hash():
+    """A digest of every table above. The parse cache is keyed on it, so that
+    changing a mapping does not serve entries converted with the old one."""
+    tables = [FIELDS, FIELDS_TO_BIBLATEX, FIELDS_TO_BIBTEX, FIELDS_SKIP,
+              FIELDS_SKIP_WITH_DOI, FIELDS_ORDER, TYPES]
+    return hashlib.sha256(json.dumps(tables, sort_keys=True).encode()).hexdigest()[:16]
+
+
+def generate_header():
+    fields = sorted(FIELDS)
+    enum = "\n".join("  %s," % field_id(name) for name in fields)
+    return HEADER + """
+#pragma once
+
+#define BIB_MAPPINGS_HASH "%s"
+
+enum BIBFieldId {
+%s
+  BIB_FIELD_KNOWN
+};
+
+enum BIBFieldFlags {
+  BIB_FIELD_SKIP = 1 << 0,
+  BIB_FIELD_SKIP_WITH_DOI = 1 << 1,
+};
+""" % (tables_hash(), enum)
+
+
+def field_orders(fields):
+    orders = {}
+    for rank, group in enumerate(FIELDS_ORDER):
+        for name in group.split():
+            assert name in FIELDS and name not in orders, name
+            orders[name] = rank
+    rest = [name for name in fields if name not in orders]
+    for rank, name in enumerate(rest, len(FIELDS_ORDER)):
+        orders[name] = rank
+    return orders
+
+
+def generate_source():
+    fields = sorted(FIELDS)
+    types = sorted(TYPES)
+    orders = field_orders(fields)
+
+    for table in (FIELDS_TO_BIBLATEX, FIELDS_TO_BIBTEX):
+        for source, target in table.items():
+            assert source in FIELDS and target in FIELDS, (source, target)
+    for name in FIELDS_SKIP + FIELDS_SKIP_WITH_DOI:
+        assert name in FIELDS, name
+
+    field_rows = []
+    for name in fields:
+        flags = []
+        if name in FIELDS_SKIP:
+            flags.append("BIB_FIELD_SKIP")
+        if name in FIELDS_SKIP_WITH_DOI:
+            flags.append("BIB_FIELD_SKIP_WITH_DOI")
+        field_rows.append([
+            c_string(name),
+            field_id(FIELDS_TO_BIBLATEX.get(name, name)),
+            field_id(FIELDS_TO_BIBTEX.get(name, name)),
+            " | ".join(flags) or "0",
+            str(orders[name]),
+        ])
+
+    type_rows = []
+    for name in types:
+        biblatex, subtype, bibtex = TYPES[name]
+        type_rows.append([c_string(name), c_string(biblatex), c_string(subtype), c_string(bibtex)])
+
+    field_seeds, field_slots = perfect_hash(fields)
+    type_seeds, type_slots = perfect_hash(types)
+
+    return HEADER + """
+#include "internal.h"
+
+#include <string.h>
+
+const BIBFieldInfo bib_fields[BIB_FIELD_KNOWN] = {
+%s
+};
+
+static const BIBTypeInfo bib_types[%d] = {
+%s
+};
+
+%s
+%s
+%s
+%s
+static guint32 mapping_hash(guint32 seed, const gchar *name, gsize length) {
+  guint32 hash = 2166136261u ^ seed;
+
+  for (gsize i = 0; i < length; i++) {
+    hash = (hash ^ (guchar)name[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+gint bib_field_lookup(const BIBString *name) {
+  guint32 seed = field_seeds[mapping_hash(0, name->str, name->len) %% G_N_ELEMENTS(field_seeds)];
+  gint index = field_slots[mapping_hash(seed, name->str, name->len) %% G_N_ELEMENTS(field_slots)];
+
+  if (index < 0 || !bib_string_equal(&bib_fields[index].name, name)) {
+    return -1;
+  }
+
+  return index;
+}
+
+const BIBTypeInfo *bib_type_lookup(const BIBString *name) {
+  guint32 seed = type_seeds[mapping_hash(0, name->str, name->len) %% G_N_ELEMENTS(type_seeds)];
+  gint index = type_slots[mapping_hash(seed, name->str, name->len) %% G_N_ELEMENTS(type_slots)];
+
+  if (index < 0 || !bib_string_equal(&bib_types[index].name, name)) {
+    return NULL;
+  }
+
+  return &bib_types[index];
+}
+""" % (
+        aligned_rows(field_rows),
+        len(types),
+        aligned_rows(type_rows),
+        c_array("guint16", "field_seeds", field_seeds),
+        c_array("gint16", "field_slots", field_slots),
+        c_array("guint16", "type_seeds", type_seeds),
+        c_array("gint16", "type_slots", type_slots),
+    )
+
+
+def main():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+    with open(os.path.join(root, "mappings.h"), "w") as f:
+        f.write(generate_header())
+    with open(os.path.join(root, "mappings.c"), "w") as f:
+        f.write(generate_source())
+
+
+if __name__ == "__main__":
+    main()